@@ -3,7 +3,9 @@
 
 #include "util/helpers.h"
 #include "util/exception.h"
+#include "bits/config.h"
 #include "evetime.h"
+#include "apicache.h"
 #include "apibase.h"
 
 void
@@ -43,6 +45,41 @@ ApiBase::check_node (xmlNodePtr node)
 
 /* ---------------------------------------------------------------- */
 
+void
+ApiBase::check_element (XmlReader& reader)
+{
+  if (!this->locally_cached && reader.is_element("currentTime"))
+  {
+    std::string text = reader.read_text();
+    EveTime::init_from_eveapi_string(text);
+  }
+
+  if (reader.is_element("cachedUntil"))
+  {
+    this->cached_until = reader.read_text();
+    this->cached_until_t = EveTime::get_time_for_string(this->cached_until);
+  }
+
+  if (reader.is_element("error"))
+  {
+    char const* code = reader.get_attribute("code");
+    std::string error = (code == 0 ? "<unknown>" : code);
+    std::string text = reader.read_text();
+
+    throw Exception("Error document received. Code: " + error + "\n" + text);
+  }
+}
+
+/* ---------------------------------------------------------------- */
+
+bool
+ApiBase::use_streaming_parser (void)
+{
+  return Config::conf.get_value("settings.streaming_parser")->get_bool();
+}
+
+/* ---------------------------------------------------------------- */
+
 void
 ApiBase::enforce_cache_time (time_t min_cache_time)
 {
@@ -54,3 +91,34 @@ ApiBase::enforce_cache_time (time_t min_cache_time)
     this->cached_until = EveTime::get_gm_time_string(min_cached, false);
   }
 }
+
+/* ---------------------------------------------------------------- */
+
+bool
+ApiBase::take_unchanged (EveApiData const& data, bool parsed)
+{
+  char const* buffer = &data.data->data[0];
+  std::size_t size = data.data->data.size();
+  uint64_t new_digest = ApiCache::get_digest(buffer, size);
+
+  this->unchanged = (parsed && new_digest == this->digest);
+  this->digest = new_digest;
+  if (!this->unchanged)
+    return false;
+
+  this->ApiBase::set_api_data(data);
+
+  if (!this->locally_cached)
+  {
+    std::string text = ApiCache::get_element_text(buffer, size,
+        "currentTime");
+    if (!text.empty())
+      EveTime::init_from_eveapi_string(text);
+  }
+
+  this->cached_until = ApiCache::get_element_text(buffer, size,
+      "cachedUntil");
+  this->cached_until_t = EveTime::get_time_for_string(this->cached_until);
+
+  return true;
+}
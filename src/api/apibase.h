@@ -14,6 +14,7 @@
 #define API_BASE_HEADER
 
 #include <string>
+#include <stdint.h>
 #include <libxml/parser.h>
 
 #include "net/http.h"
@@ -42,22 +43,40 @@ class ApiBase : public XmlBase
     bool locally_cached;
     std::string cached_until;
     time_t cached_until_t;
+    /* Digest of the document without the volatile elements. */
+    uint64_t digest;
+    bool unchanged;
 
     /* Extracts some common information like errors,
      * the EVE time and the cache time. */
     void check_node (xmlNodePtr node);
+    /* The same for the current element of a streaming parser. */
+    void check_element (XmlReader& reader);
+
+    /* Returns true if documents are parsed with the streaming parser
+     * instead of building a DOM tree first. */
+    static bool use_streaming_parser (void);
 
     /* Sets cached_until and cached_until_t with respect
      * to min_cache_time to ensure a minimum cache time.
      * Does not overwrite greater cache times. */
     void enforce_cache_time (time_t min_cache_time);
 
+    /* Compares the digest of the document with the one parsed before.
+     * If the document is unchanged and the previous one was parsed
+     * successfully, only the cache information is taken over and true
+     * is returned. The document then needs no parsing. */
+    bool take_unchanged (EveApiData const& data, bool parsed);
+
   public:
     ApiBase (void);
     virtual ~ApiBase (void);
     virtual void set_api_data (EveApiData const& data);
 
     bool is_locally_cached (void) const;
+    /* Returns true if the last document was the same as the one
+     * before and only the cache information has been updated. */
+    bool is_unchanged (void) const;
     std::string const& get_cached_until (void) const;
     time_t get_cached_until_t (void) const;
     HttpDataPtr get_http_data (void) const;
@@ -70,6 +89,8 @@ ApiBase::ApiBase (void)
 {
   this->locally_cached = false;
   this->cached_until_t = 0;
+  this->digest = 0;
+  this->unchanged = false;
 }
 
 inline
@@ -108,4 +129,10 @@ ApiBase::is_locally_cached (void) const
   return this->locally_cached;
 }
 
+inline bool
+ApiBase::is_unchanged (void) const
+{
+  return this->unchanged;
+}
+
 #endif /* API_BASE_HEADER */
@@ -0,0 +1,473 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <iostream>
+#include <new>
+#include <zlib.h>
+
+#include "util/os.h"
+#include "util/helpers.h"
+#include "util/exception.h"
+#include "evetime.h"
+#include "apicache.h"
+
+#define API_CACHE_INDEX_MAGIC "GtkEveMon-SheetIndex"
+#define API_CACHE_SUFFIX ".gz"
+
+ApiCache::EntryList ApiCache::entries;
+ApiCache::IndexMap ApiCache::index;
+std::string ApiCache::index_dir;
+Semaphore ApiCache::lock;
+
+/* ---------------------------------------------------------------- */
+
+HttpDataPtr
+ApiCache::load (std::string const& filename)
+{
+  /* Sheets cached by older versions are not compressed. */
+  std::string path = filename + API_CACHE_SUFFIX;
+  bool compressed = true;
+  time_t mtime = OS::file_mtime(path.c_str());
+  if (mtime == 0)
+  {
+    path = filename;
+    compressed = false;
+    mtime = OS::file_mtime(path.c_str());
+  }
+  if (mtime == 0)
+    return HttpDataPtr();
+
+  /* Serve from memory if the file is unchanged. */
+  ApiCache::lock.wait();
+  for (EntryList::iterator iter = ApiCache::entries.begin();
+      iter != ApiCache::entries.end(); iter++)
+  {
+    if (iter->filename != path)
+      continue;
+
+    if (iter->mtime == mtime)
+    {
+      HttpDataPtr data = iter->data;
+      ApiCache::entries.splice(ApiCache::entries.begin(),
+          ApiCache::entries, iter);
+      ApiCache::lock.post();
+      return data;
+    }
+
+    ApiCache::entries.erase(iter);
+    break;
+  }
+  ApiCache::lock.post();
+
+  std::size_t size = 0;
+  char const* mapped = (char const*)OS::map_file(path.c_str(), &size);
+  if (mapped == 0)
+    return HttpDataPtr();
+
+  HttpDataPtr data = HttpData::create();
+  bool success = true;
+  if (compressed)
+    success = ApiCache::inflate_data(mapped, size, &data->data);
+  else
+  {
+    data->reserve_data(size);
+    data->data.assign(mapped, mapped + size);
+  }
+  OS::unmap_file((void*)mapped, size);
+
+  if (!success || data->data.empty())
+  {
+    std::cout << "Warning: Invalid cache file " << path << std::endl;
+    return HttpDataPtr();
+  }
+
+  /* Sheets are stored with the terminating zero. */
+  if (data->data.back() != '\0')
+    data->data.push_back('\0');
+
+  ApiCache::remember(path, mtime, data);
+  return data;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+ApiCache::store (std::string const& filename, HttpDataPtr data)
+{
+  std::string dir, name;
+  ApiCache::split_filename(filename, &dir, &name);
+  std::string path = filename + API_CACHE_SUFFIX;
+
+  char const* buffer = &data->data[0];
+  std::size_t size = data->data.size();
+
+  ApiCacheIndexEntry entry;
+  entry.cached_until = ApiCache::get_cached_until(buffer, size);
+  entry.digest = ApiCache::get_digest(buffer, size);
+  entry.size = size;
+
+  ApiCache::lock.wait();
+  ApiCache::load_index(dir);
+
+  /* Unchanged sheets are not written again. */
+  IndexMap::iterator iter = ApiCache::index.find(name);
+  bool unchanged = iter != ApiCache::index.end()
+      && iter->second.digest == entry.digest
+      && iter->second.size == entry.size
+      && OS::file_exists(path.c_str());
+  bool legacy = iter == ApiCache::index.end();
+  ApiCache::index[name] = entry;
+  ApiCache::lock.post();
+
+  if (!unchanged)
+  {
+    std::string compressed;
+    ApiCache::deflate_data(buffer, size, &compressed);
+
+    std::string tmp_fn = path + ".tmp";
+    Helpers::write_file(tmp_fn, compressed);
+    if (!OS::rename_file(tmp_fn.c_str(), path.c_str()))
+    {
+      OS::unlink(tmp_fn.c_str());
+      throw FileException(path, ::strerror(errno));
+    }
+
+    /* Remove the uncompressed sheet of older versions. */
+    if (legacy)
+      OS::unlink(filename.c_str());
+  }
+
+  ApiCache::lock.wait();
+  ApiCache::save_index();
+  ApiCache::lock.post();
+
+  ApiCache::remember(path, OS::file_mtime(path.c_str()), data);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+ApiCache::clear (void)
+{
+  ApiCache::lock.wait();
+  ApiCache::entries.clear();
+  ApiCache::lock.post();
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+ApiCache::unload (void)
+{
+  ApiCache::lock.wait();
+  ApiCache::entries.clear();
+  ApiCache::index.clear();
+  ApiCache::index_dir.clear();
+  ApiCache::lock.post();
+}
+
+/* ---------------------------------------------------------------- */
+
+bool
+ApiCache::get_index_entry (std::string const& filename,
+    ApiCacheIndexEntry* entry)
+{
+  std::string dir, name;
+  ApiCache::split_filename(filename, &dir, &name);
+
+  ApiCache::lock.wait();
+  ApiCache::load_index(dir);
+  IndexMap::iterator iter = ApiCache::index.find(name);
+  bool found = (iter != ApiCache::index.end());
+  if (found)
+    *entry = iter->second;
+  ApiCache::lock.post();
+
+  return found;
+}
+
+/* ---------------------------------------------------------------- */
+
+uint64_t
+ApiCache::get_digest (char const* data, std::size_t size)
+{
+  char const* volatile_tags[] = { "<currentTime>", "<cachedUntil>" };
+
+  /* HTTP documents carry a terminating zero, files may not. */
+  while (size > 0 && data[size - 1] == '\0')
+    size -= 1;
+
+  /* FNV-1a over everything except the volatile element contents.
+   * Tags are located with memchr, which scans much faster than a
+   * byte by byte state machine. */
+  uint64_t hash = 14695981039346656037ull;
+  char const* pos = data;
+  char const* end = data + size;
+  while (pos < end)
+  {
+    char const* tag = (char const*)std::memchr(pos, '<',
+        (std::size_t)(end - pos));
+    char const* span_end = (tag == 0 ? end : tag + 1);
+    for (; pos < span_end; ++pos)
+    {
+      hash ^= (unsigned char)*pos;
+      hash *= 1099511628211ull;
+    }
+    if (tag == 0)
+      break;
+
+    for (std::size_t i = 0; i < 2; ++i)
+    {
+      std::size_t len = std::strlen(volatile_tags[i]);
+      if ((std::size_t)(end - tag) < len
+          || std::memcmp(tag, volatile_tags[i], len))
+        continue;
+
+      /* Skip the element text up to the closing tag. */
+      pos = tag + len;
+      char const* close = (char const*)std::memchr(pos, '<',
+          (std::size_t)(end - pos));
+      pos = (close == 0 ? end : close);
+      break;
+    }
+  }
+
+  return hash;
+}
+
+/* ---------------------------------------------------------------- */
+
+std::string
+ApiCache::get_element_text (char const* data, std::size_t size,
+    char const* name)
+{
+  std::string tag = "<";
+  tag += name;
+  tag += ">";
+  char const* end = data + size;
+  char const* pos = std::search(data, end, tag.begin(), tag.end());
+  if (pos == end)
+    return std::string();
+
+  pos += tag.size();
+  char const* value_end = std::find(pos, end, '<');
+  if (value_end == end)
+    return std::string();
+
+  return std::string(pos, value_end);
+}
+
+/* ---------------------------------------------------------------- */
+
+time_t
+ApiCache::get_cached_until (char const* data, std::size_t size)
+{
+  std::string text = ApiCache::get_element_text(data, size, "cachedUntil");
+  if (text.empty())
+    return 0;
+
+  time_t ret = EveTime::get_time_for_string(text);
+  return ret < 0 ? 0 : ret;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+ApiCache::remember (std::string const& filename,
+    time_t mtime, HttpDataPtr data)
+{
+  ApiCache::lock.wait();
+  for (EntryList::iterator iter = ApiCache::entries.begin();
+      iter != ApiCache::entries.end(); iter++)
+  {
+    if (iter->filename == filename)
+    {
+      ApiCache::entries.erase(iter);
+      break;
+    }
+  }
+
+  Entry entry;
+  entry.filename = filename;
+  entry.mtime = mtime;
+  entry.data = data;
+  ApiCache::entries.push_front(entry);
+
+  if (ApiCache::entries.size() > API_CACHE_MAX_ENTRIES)
+    ApiCache::entries.pop_back();
+  ApiCache::lock.post();
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+ApiCache::load_index (std::string const& dir)
+{
+  if (ApiCache::index_dir == dir)
+    return;
+
+  ApiCache::index.clear();
+  ApiCache::index_dir = dir;
+
+  std::string content;
+  try
+  {
+    Helpers::read_file(dir + "/" API_CACHE_INDEX_FILE, &content);
+  }
+  catch (Exception&)
+  {
+    return;
+  }
+
+  std::istringstream in(content);
+  std::string magic;
+  int version = 0;
+  in >> magic >> version;
+  if (magic != API_CACHE_INDEX_MAGIC || version != API_CACHE_INDEX_VERSION)
+    return;
+
+  while (true)
+  {
+    std::string name;
+    ApiCacheIndexEntry entry;
+    in >> name >> entry.cached_until >> std::hex >> entry.digest
+        >> std::dec >> entry.size;
+    if (in.fail())
+      break;
+    ApiCache::index[name] = entry;
+  }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+ApiCache::save_index (void)
+{
+  std::ostringstream out;
+  out << API_CACHE_INDEX_MAGIC << " " << API_CACHE_INDEX_VERSION << "\n";
+  for (IndexMap::iterator iter = ApiCache::index.begin();
+      iter != ApiCache::index.end(); iter++)
+  {
+    out << iter->first << " " << iter->second.cached_until
+        << " " << std::hex << iter->second.digest << std::dec
+        << " " << iter->second.size << "\n";
+  }
+
+  std::string index_fn = ApiCache::index_dir + "/" API_CACHE_INDEX_FILE;
+  std::string tmp_fn = index_fn + ".tmp";
+  try
+  {
+    Helpers::write_file(tmp_fn, out.str());
+    if (!OS::rename_file(tmp_fn.c_str(), index_fn.c_str()))
+      OS::unlink(tmp_fn.c_str());
+  }
+  catch (Exception& e)
+  {
+    std::cout << "Warning: Cannot write cache index: " << e << std::endl;
+  }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+ApiCache::split_filename (std::string const& filename,
+    std::string* dir, std::string* name)
+{
+  std::size_t pos = filename.find_last_of("/\\");
+  if (pos == std::string::npos)
+  {
+    *dir = ".";
+    *name = filename;
+  }
+  else
+  {
+    *dir = filename.substr(0, pos);
+    *name = filename.substr(pos + 1);
+  }
+}
+
+/* ---------------------------------------------------------------- */
+
+bool
+ApiCache::inflate_data (char const* src, std::size_t size,
+    std::vector<char>* dest)
+{
+  /* The gzip trailer stores the uncompressed size. It is only used as
+   * a hint, since a corrupt file could ask for gigabytes. */
+  if (size < 18)
+    return false;
+  unsigned char const* trailer = (unsigned char const*)src + size - 4;
+  std::size_t raw_size = (std::size_t)trailer[0]
+      | ((std::size_t)trailer[1] << 8)
+      | ((std::size_t)trailer[2] << 16)
+      | ((std::size_t)trailer[3] << 24);
+  raw_size = std::min(raw_size, size * 16);
+  raw_size = std::min(raw_size, (std::size_t)API_CACHE_MAX_SHEET_SIZE);
+
+  z_stream stream;
+  std::memset(&stream, 0, sizeof(z_stream));
+  if (::inflateInit2(&stream, 15 + 16) != Z_OK)
+    return false;
+
+  int ret = Z_OK;
+  try
+  {
+    /* One more byte, so the buffer only grows if the hint was wrong. */
+    dest->resize(raw_size + 1);
+    stream.next_in = (Bytef*)src;
+    stream.avail_in = (uInt)size;
+    while (true)
+    {
+      stream.next_out = (Bytef*)&(*dest)[stream.total_out];
+      stream.avail_out = (uInt)(dest->size() - stream.total_out);
+      ret = ::inflate(&stream, Z_NO_FLUSH);
+      if (ret != Z_OK)
+        break;
+
+      /* Output buffer is full, grow it. */
+      if (stream.avail_out == 0)
+      {
+        if (dest->size() >= API_CACHE_MAX_SHEET_SIZE)
+          break;
+        dest->resize(std::min(dest->size() * 2,
+            (std::size_t)API_CACHE_MAX_SHEET_SIZE));
+      }
+      else if (stream.avail_in == 0)
+        break;
+    }
+    dest->resize(stream.total_out);
+  }
+  catch (std::bad_alloc&)
+  {
+    ret = Z_MEM_ERROR;
+  }
+  ::inflateEnd(&stream);
+
+  return ret == Z_STREAM_END;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+ApiCache::deflate_data (char const* src, std::size_t size,
+    std::string* dest)
+{
+  z_stream stream;
+  std::memset(&stream, 0, sizeof(z_stream));
+  if (::deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+      15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    throw Exception("Cannot initialize compression");
+
+  dest->resize(::deflateBound(&stream, (uLong)size));
+  stream.next_in = (Bytef*)src;
+  stream.avail_in = (uInt)size;
+  stream.next_out = (Bytef*)&(*dest)[0];
+  stream.avail_out = (uInt)dest->size();
+  int ret = ::deflate(&stream, Z_FINISH);
+  dest->resize(stream.total_out);
+  ::deflateEnd(&stream);
+
+  if (ret != Z_STREAM_END)
+    throw Exception("Cannot compress sheet");
+}
@@ -0,0 +1,116 @@
+/*
+ * This file is part of GtkEveMon.
+ *
+ * GtkEveMon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GtkEveMon. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef API_CACHE_HEADER
+#define API_CACHE_HEADER
+
+#include <list>
+#include <map>
+#include <vector>
+#include <string>
+#include <ctime>
+#include <stdint.h>
+
+#include "util/thread.h"
+#include "net/http.h"
+
+/* Amount of recently used sheets kept in memory. */
+#define API_CACHE_MAX_ENTRIES 32
+/* File name of the index in the cache directory. */
+#define API_CACHE_INDEX_FILE "index"
+/* Increase whenever the format of the index changes. */
+#define API_CACHE_INDEX_VERSION 1
+/* Larger cached sheets are treated as corrupt. */
+#define API_CACHE_MAX_SHEET_SIZE (64 * 1024 * 1024)
+
+/*
+ * Information about a cached sheet kept in the index. The digest
+ * ignores volatile elements, see ApiCache::get_digest().
+ */
+struct ApiCacheIndexEntry
+{
+  time_t cached_until;
+  uint64_t digest;
+  std::size_t size;
+};
+
+/* ---------------------------------------------------------------- */
+
+/*
+ * Disc cache for API sheets. Sheets are stored gzip compressed next to
+ * the given file name with an additional ".gz" suffix. They are written
+ * to a temporary file and renamed, so a crash never leaves a truncated
+ * sheet behind. If the digest of a new sheet matches the cached one,
+ * only the index is updated and the stored sheet keeps its older
+ * cachedUntil. The index keeps cachedUntil, digest and size of every
+ * sheet in the directory.
+ * Recently stored or loaded sheets are kept in memory and returned
+ * directly as long as the file has not been modified.
+ */
+class ApiCache
+{
+  private:
+    struct Entry
+    {
+      std::string filename;
+      time_t mtime;
+      HttpDataPtr data;
+    };
+
+    typedef std::list<Entry> EntryList;
+    typedef std::map<std::string, ApiCacheIndexEntry> IndexMap;
+
+    /* Most recently used entry first. */
+    static EntryList entries;
+    static IndexMap index;
+    static std::string index_dir;
+    static Semaphore lock;
+
+    static void remember (std::string const& filename,
+        time_t mtime, HttpDataPtr data);
+    static void load_index (std::string const& dir);
+    static void save_index (void);
+    static void split_filename (std::string const& filename,
+        std::string* dir, std::string* name);
+    static bool inflate_data (char const* src, std::size_t size,
+        std::vector<char>* dest);
+    static void deflate_data (char const* src, std::size_t size,
+        std::string* dest);
+
+  public:
+    /* Returns the cached sheet or an empty pointer if not available.
+     * The document is terminated with a zero like HTTP documents. */
+    static HttpDataPtr load (std::string const& filename);
+    /* Writes the sheet to disc. Throws an exception on error. */
+    static void store (std::string const& filename, HttpDataPtr data);
+    /* Drops all sheets from memory. */
+    static void clear (void);
+    /* Drops sheets and index from memory. Called on exit. */
+    static void unload (void);
+
+    /* Returns the index entry for the sheet, or false if unknown. */
+    static bool get_index_entry (std::string const& filename,
+        ApiCacheIndexEntry* entry);
+
+    /* Returns a hash of the document that ignores the contents of
+     * the <currentTime> and <cachedUntil> elements. */
+    static uint64_t get_digest (char const* data, std::size_t size);
+    /* Returns the text of the first element with the given name
+     * without parsing the document. Returns an empty string if the
+     * element is not found. */
+    static std::string get_element_text (char const* data,
+        std::size_t size, char const* name);
+    /* Returns the value of the <cachedUntil> element or 0. */
+    static time_t get_cached_until (char const* data, std::size_t size);
+};
+
+#endif /* API_CACHE_HEADER */
@@ -13,6 +13,7 @@
 #define CERTTREE_FN "CertificateTree.xml"
 
 ApiCertTreePtr ApiCertTree::instance;
+std::list<ApiCertTreePtr> ApiCertTree::retired;
 
 /* ---------------------------------------------------------------- */
 
@@ -20,10 +21,7 @@ ApiCertTreePtr
 ApiCertTree::request (void)
 {
   if (ApiCertTree::instance.get() == 0)
-  {
-    ApiCertTree::instance = ApiCertTreePtr(new ApiCertTree);
-    ApiCertTree::instance->refresh();
-  }
+    ApiCertTree::refresh();
 
   return ApiCertTree::instance;
 }
@@ -41,7 +39,7 @@ ApiCertTree::refresh (void)
 {
   try
   {
-    this->parse_xml(this->get_filename());
+    ApiCertTree::publish(ApiCertTree::load());
     return;
   }
   catch (Exception& e)
@@ -56,8 +54,29 @@ ApiCertTree::refresh (void)
 
 /* ---------------------------------------------------------------- */
 
+ApiCertTreePtr
+ApiCertTree::load (void)
+{
+  ApiCertTreePtr tree = make_ref<ApiCertTree>();
+  tree->parse_xml(ApiCertTree::get_filename());
+  return tree;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+ApiCertTree::publish (ApiCertTreePtr tree)
+{
+  /* Keep the previous tree, there may be pointers to its certs. */
+  if (ApiCertTree::instance.get() != 0)
+    ApiCertTree::retired.push_back(ApiCertTree::instance);
+  ApiCertTree::instance = tree;
+}
+
+/* ---------------------------------------------------------------- */
+
 std::string
-ApiCertTree::get_filename (void) const
+ApiCertTree::get_filename (void)
 {
   return Config::get_conf_dir() + "/" CERTTREE_FN;
 }
@@ -67,20 +86,279 @@ ApiCertTree::get_filename (void) const
 void
 ApiCertTree::parse_xml (std::string const& filename)
 {
-  /* Try to read the document. */
-  XmlDocumentPtr xml = XmlDocument::create_from_file(filename);
-  xmlNodePtr root = xml->get_root_element();
+  /* Use the binary cache if it was created from this very file.
+   * Otherwise the document is parsed from the mapped file. */
+  TreeCacheSource source;
+  source.open(filename);
+  if (this->read_cache(filename + ".cache", source))
+    return;
 
   std::cout << "Parsing XML: " CERTTREE_FN "... ";
   std::cout.flush();
 
+  if (ApiBase::use_streaming_parser())
+    this->parse_stream(source.get_data(), source.get_size());
+  else
+    this->parse_dom(source.get_data(), source.get_size());
+  std::cout << this->certificates.size() << " certs." << std::endl;
+
+  this->write_cache(filename + ".cache", source.get_key());
+}
+
+/* ---------------------------------------------------------------- */
+
+bool
+ApiCertTree::read_cache (std::string const& filename, TreeCacheSource& source)
+{
+  TreeCacheReader cache;
+  if (!cache.open(filename, source))
+    return false;
+
+  std::cout << "Reading cache: " CERTTREE_FN "... " << std::flush;
+
+  this->certificates.clear();
+  this->categories.clear();
+  this->classes.clear();
+
+  try
+  {
+    int num_categories = cache.read_int();
+    for (int i = 0; i < num_categories; ++i)
+    {
+      ApiCertCategory category;
+      category.id = cache.read_int();
+      category.name = cache.read_string();
+      this->categories.insert(std::make_pair(category.id, category));
+    }
+
+    int num_classes = cache.read_int();
+    for (int i = 0; i < num_classes; ++i)
+    {
+      ApiCertClass certclass;
+      certclass.id = cache.read_int();
+      certclass.name = cache.read_string();
+      certclass.cat_details = this->get_category_for_id(cache.read_int());
+      this->classes.insert(std::make_pair(certclass.id, certclass));
+    }
+
+    int num_certs = cache.read_int();
+    for (int i = 0; i < num_certs; ++i)
+    {
+      ApiCert cert;
+      cert.id = cache.read_int();
+      cert.grade = cache.read_int();
+      cert.desc = cache.read_string();
+      cert.class_details = this->get_class_for_id(cache.read_int());
+
+      int num_skilldeps = cache.read_int();
+      for (int j = 0; j < num_skilldeps; ++j)
+      {
+        int skill_id = cache.read_int();
+        int skill_level = cache.read_int();
+        cert.skilldeps.push_back(std::make_pair(skill_id, skill_level));
+      }
+
+      int num_certdeps = cache.read_int();
+      for (int j = 0; j < num_certdeps; ++j)
+      {
+        int cert_id = cache.read_int();
+        int cert_grade = cache.read_int();
+        cert.certdeps.push_back(std::make_pair(cert_id, cert_grade));
+      }
+
+      this->certificates.insert(std::make_pair(cert.id, cert));
+    }
+
+    if (!cache.at_end())
+      throw Exception("Trailing data in tree cache");
+  }
+  catch (Exception& e)
+  {
+    std::cout << e << std::endl;
+    this->certificates.clear();
+    this->categories.clear();
+    this->classes.clear();
+    return false;
+  }
+
+  std::cout << this->certificates.size() << " certs." << std::endl;
+  return true;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+ApiCertTree::write_cache (std::string const& filename, TreeCacheKey const& key)
+{
+  TreeCacheWriter cache;
+
+  cache.write_int((int)this->categories.size());
+  for (ApiCertCategoryMap::const_iterator iter = this->categories.begin();
+      iter != this->categories.end(); iter++)
+  {
+    cache.write_int(iter->second.id);
+    cache.write_string(iter->second.name);
+  }
+
+  cache.write_int((int)this->classes.size());
+  for (ApiCertClassMap::const_iterator iter = this->classes.begin();
+      iter != this->classes.end(); iter++)
+  {
+    cache.write_int(iter->second.id);
+    cache.write_string(iter->second.name);
+    cache.write_int(iter->second.cat_details->id);
+  }
+
+  cache.write_int((int)this->certificates.size());
+  for (ApiCertMap::const_iterator iter = this->certificates.begin();
+      iter != this->certificates.end(); iter++)
+  {
+    ApiCert const& cert = iter->second;
+    cache.write_int(cert.id);
+    cache.write_int(cert.grade);
+    cache.write_string(cert.desc);
+    cache.write_int(cert.class_details->id);
+
+    cache.write_int((int)cert.skilldeps.size());
+    for (std::size_t i = 0; i < cert.skilldeps.size(); ++i)
+    {
+      cache.write_int(cert.skilldeps[i].first);
+      cache.write_int(cert.skilldeps[i].second);
+    }
+
+    cache.write_int((int)cert.certdeps.size());
+    for (std::size_t i = 0; i < cert.certdeps.size(); ++i)
+    {
+      cache.write_int(cert.certdeps[i].first);
+      cache.write_int(cert.certdeps[i].second);
+    }
+  }
+
+  try
+  {
+    cache.save(filename, key);
+  }
+  catch (Exception& e)
+  {
+    std::cout << "Error writing cert tree cache: " << e << std::endl;
+  }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+ApiCertTree::parse_dom (char const* data, std::size_t size)
+{
+  XmlDocumentPtr xml = XmlDocument::create(data, size);
+  xmlNodePtr root = xml->get_root_element();
+
   /* Document was parsed. Reset information. */
   this->certificates.clear();
   this->categories.clear();
   this->classes.clear();
 
   this->parse_eveapi_tag(root);
-  std::cout << this->certificates.size() << " certs." << std::endl;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+ApiCertTree::parse_stream (char const* data, std::size_t size)
+{
+  XmlReader reader(data, size);
+  if (!reader.next_element() || !reader.is_element("eveapi"))
+    throw Exception("Invalid tag. Expecting <eveapi> node");
+
+  this->certificates.clear();
+  this->categories.clear();
+  this->classes.clear();
+
+  ApiCertCategory* category = 0;
+  ApiCertClass* cclass = 0;
+  ApiCert* cert = 0;
+  bool skill_deps = false;
+
+  /* Depth of the deepest element on the current path that is parsed.
+   * Rowsets are on even, rows on odd depths. */
+  int matched = 0;
+  while (reader.next_element())
+  {
+    int depth = reader.get_depth();
+    if (depth > matched + 1)
+      continue;
+    matched = depth - 1;
+
+    if (depth == 1 && reader.is_element("result"))
+      matched = 1;
+    else if (depth >= 2 && depth <= 6 && depth % 2 == 0
+        && reader.is_element("rowset"))
+      matched = depth;
+    else if (depth == 3 && reader.is_element("row"))
+    {
+      ApiCertCategory cat;
+      cat.name = reader.get_attribute_string("categoryName");
+      cat.id = reader.get_attribute_int("categoryID");
+
+      ApiCertCategoryMap::iterator ins = this->categories.insert
+          (std::make_pair(cat.id, cat)).first;
+      category = &ins->second;
+      matched = 3;
+    }
+    else if (depth == 5 && reader.is_element("row"))
+    {
+      ApiCertClass certclass;
+      certclass.name = reader.get_attribute_string("className");
+      certclass.id = reader.get_attribute_int("classID");
+      certclass.cat_details = category;
+
+      ApiCertClassMap::iterator ins = this->classes.insert
+          (std::make_pair(certclass.id, certclass)).first;
+      cclass = &ins->second;
+      matched = 5;
+    }
+    else if (depth == 7 && reader.is_element("row"))
+    {
+      ApiCert certificate;
+      certificate.class_details = cclass;
+      certificate.id = reader.get_attribute_int("certificateID");
+      certificate.grade = reader.get_attribute_int("grade");
+      certificate.desc = reader.get_attribute_string("description");
+
+      ApiCertMap::iterator ins = this->certificates.insert
+          (std::make_pair(certificate.id, certificate)).first;
+      cert = &ins->second;
+      matched = 7;
+    }
+    else if (depth == 8 && reader.is_element("rowset"))
+    {
+      std::string name = reader.get_attribute_string("name");
+      if (name == "requiredSkills")
+      {
+        skill_deps = true;
+        matched = 8;
+      }
+      else if (name == "requiredCertificates")
+      {
+        skill_deps = false;
+        matched = 8;
+      }
+    }
+    else if (depth == 9 && reader.is_element("row"))
+    {
+      if (skill_deps)
+      {
+        int skill_id = reader.get_attribute_int("typeID");
+        int skill_level = reader.get_attribute_int("level");
+        cert->skilldeps.push_back(std::make_pair(skill_id, skill_level));
+      }
+      else
+      {
+        int cert_id = reader.get_attribute_int("certificateID");
+        int cert_grade = reader.get_attribute_int("grade");
+        cert->certdeps.push_back(std::make_pair(cert_id, cert_grade));
+      }
+    }
+  }
 }
 
 /* ---------------------------------------------------------------- */
@@ -15,11 +15,13 @@
 
 #include <vector>
 #include <string>
+#include <list>
 #include <map>
 #include <libxml/parser.h>
 
 #include "util/ref_ptr.h"
 #include "apibase.h"
+#include "treecache.h"
 
 struct ApiCertCategory
 {
@@ -65,14 +67,24 @@ typedef std::map<int, ApiCert> ApiCertMap;
 typedef std::map<int, ApiCertCategory> ApiCertCategoryMap;
 typedef std::map<int, ApiCertClass> ApiCertClassMap;
 
+/*
+ * A cert tree is not modified once it is published. A refresh parses
+ * a new tree and replaces the published one. Previous trees are kept,
+ * so pointers to certificates stay valid for the whole runtime.
+ */
 class ApiCertTree : public ApiBase
 {
   private:
     static ApiCertTreePtr instance;
+    static std::list<ApiCertTreePtr> retired;
 
   protected:
     ApiCertTree (void);
     void parse_xml (std::string const& filename);
+    bool read_cache (std::string const& filename, TreeCacheSource& source);
+    void write_cache (std::string const& filename, TreeCacheKey const& key);
+    void parse_dom (char const* data, std::size_t size);
+    void parse_stream (char const* data, std::size_t size);
     void parse_eveapi_tag (xmlNodePtr node);
     void parse_result_tag (xmlNodePtr node);
     void parse_categories_rowset (xmlNodePtr node);
@@ -89,9 +101,17 @@ class ApiCertTree : public ApiBase
     ApiCertClassMap classes;
 
   public:
+    /* Returns the published tree. Loads it on first use. */
     static ApiCertTreePtr request (void);
-    void refresh (void);
-    std::string get_filename (void) const;
+    /* Loads and publishes a new tree. Exits if it cannot be loaded. */
+    static void refresh (void);
+    /* Parses the data file into a new tree. This can be used from
+     * any thread. Throws an exception on error. */
+    static ApiCertTreePtr load (void);
+    /* Replaces the tree returned by request(). Readers of the
+     * previous tree are not affected. Call from the main thread. */
+    static void publish (ApiCertTreePtr tree);
+    static std::string get_filename (void);
 
     ApiCertClass const* get_class_for_id (int id) const;
     ApiCertCategory const* get_category_for_id (int id) const;
@@ -64,7 +64,7 @@ ApiCharacterList::ApiCharacterList (void)
 inline ApiCharacterListPtr
 ApiCharacterList::create (void)
 {
-  return ApiCharacterListPtr(new ApiCharacterList);
+  return make_ref<ApiCharacterList>();
 }
 
 inline void
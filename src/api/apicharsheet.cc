@@ -14,6 +14,13 @@
 void
 ApiCharSheet::set_api_data (EveApiData const& data)
 {
+  /* Keep the parsed sheet if the document did not change. */
+  if (this->take_unchanged(data, this->valid))
+  {
+    this->enforce_cache_time(API_CHAR_SHEET_MIN_CACHE_TIME);
+    return;
+  }
+
   this->valid = false;
   this->ApiBase::set_api_data(data);
 
@@ -82,6 +89,9 @@ ApiCharSheet::set_api_data (EveApiData const& data)
     ccert.details = cert;
   }
 
+  /* Unknown skills and certs may have been removed. */
+  this->rebuild_indices();
+
   //this->debug_dump();
   this->valid = true;
 }
@@ -92,16 +102,217 @@ void
 ApiCharSheet::parse_xml (void)
 {
   this->skills.clear();
+  this->certs.clear();
+  this->skill_index.clear();
+  this->cert_index.clear();
+  this->class_grades.clear();
 
   std::cout << "Parsing XML: CharacterSheet.xml ..." << std::endl;
-  XmlDocumentPtr xml = XmlDocument::create
-      (&this->http_data->data[0], this->http_data->data.size());
+  char const* data = &this->http_data->data[0];
+  std::size_t size = this->http_data->data.size();
+  if (ApiBase::use_streaming_parser())
+    this->parse_stream(data, size);
+  else
+    this->parse_dom(data, size);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+ApiCharSheet::parse_dom (char const* data, std::size_t size)
+{
+  XmlDocumentPtr xml = XmlDocument::create(data, size);
   xmlNodePtr root = xml->get_root_element();
   this->parse_eveapi_tag(root);
 }
 
 /* ---------------------------------------------------------------- */
 
+void
+ApiCharSheet::parse_stream (char const* data, std::size_t size)
+{
+  XmlReader reader(data, size);
+  if (!reader.next_element() || !reader.is_element("eveapi"))
+    throw Exception("Invalid XML root. Expecting <eveapi> node.");
+
+  enum
+  {
+    SECTION_ATTRIBUTES,
+    SECTION_ENHANCERS,
+    SECTION_SKILLS,
+    SECTION_CERTS
+  } section = SECTION_ATTRIBUTES;
+  double* bonus = 0;
+
+  /* Depth of the deepest element on the current path that is parsed. */
+  int matched = 0;
+  while (reader.next_element())
+  {
+    int depth = reader.get_depth();
+    if (depth > matched + 1)
+      continue;
+    matched = depth - 1;
+
+    if (depth == 1)
+    {
+      /* Let the base class know of some fields. */
+      this->check_element(reader);
+      if (reader.is_element("result"))
+        matched = 1;
+    }
+    else if (depth == 2)
+    {
+      if (reader.is_element("characterID"))
+        this->char_id = reader.read_text();
+      else if (reader.is_element("name"))
+        this->name = reader.read_text();
+      else if (reader.is_element("race"))
+        this->race = reader.read_text();
+      else if (reader.is_element("bloodLine"))
+        this->bloodline = reader.read_text();
+      else if (reader.is_element("gender"))
+        this->gender = reader.read_text();
+      else if (reader.is_element("corporationName"))
+        this->corp = reader.read_text();
+      else if (reader.is_element("balance"))
+        this->balance = reader.read_text();
+      else if (reader.is_element("cloneName"))
+        this->clone_name = reader.read_text();
+      else if (reader.is_element("cloneSkillPoints"))
+        this->clone_sp = Helpers::get_uint_from_string(reader.read_text());
+      else if (reader.is_element("freeSkillPoints"))
+        this->free_sp = Helpers::get_uint_from_string(reader.read_text());
+      else if (reader.is_element("lastRespecDate"))
+        this->last_respec = reader.read_text();
+      else if (reader.is_element("lastTimedRespec"))
+        this->last_timed_respec = reader.read_text();
+      else if (reader.is_element("freeRespecs"))
+        this->free_respecs = Helpers::get_uint_from_string(reader.read_text());
+      else if (reader.is_element("cloneJumpDate"))
+        this->last_clone_jump = reader.read_text();
+      else if (reader.is_element("attributes"))
+      {
+        section = SECTION_ATTRIBUTES;
+        matched = 2;
+      }
+      else if (reader.is_element("attributeEnhancers"))
+      {
+        section = SECTION_ENHANCERS;
+        matched = 2;
+      }
+      else if (reader.is_element("rowset"))
+      {
+        std::string name = reader.get_attribute_string("name");
+        if (name == "skills")
+        {
+          section = SECTION_SKILLS;
+          matched = 2;
+        }
+        else if (name == "certificates")
+        {
+          section = SECTION_CERTS;
+          matched = 2;
+        }
+      }
+    }
+    else if (depth == 3 && section == SECTION_ATTRIBUTES)
+    {
+      double* attrib = 0;
+      if (reader.is_element("intelligence"))
+        attrib = &this->base.intl;
+      else if (reader.is_element("memory"))
+        attrib = &this->base.mem;
+      else if (reader.is_element("charisma"))
+        attrib = &this->base.cha;
+      else if (reader.is_element("perception"))
+        attrib = &this->base.per;
+      else if (reader.is_element("willpower"))
+        attrib = &this->base.wil;
+
+      if (attrib != 0)
+        *attrib = Helpers::get_double_from_string(reader.read_text());
+    }
+    else if (depth == 3 && section == SECTION_ENHANCERS)
+    {
+      bonus = 0;
+      if (reader.is_element("memoryBonus"))
+        bonus = &this->implant.mem;
+      else if (reader.is_element("willpowerBonus"))
+        bonus = &this->implant.wil;
+      else if (reader.is_element("perceptionBonus"))
+        bonus = &this->implant.per;
+      else if (reader.is_element("intelligenceBonus"))
+        bonus = &this->implant.intl;
+      else if (reader.is_element("charismaBonus"))
+        bonus = &this->implant.cha;
+
+      if (bonus != 0)
+        matched = 3;
+    }
+    else if (depth == 3 && section == SECTION_SKILLS
+        && reader.is_element("row"))
+    {
+      /* Prepare a new skill to append. */
+      ApiCharSheetSkill skill;
+
+      /* Fetch these fields. If they are not there, it's an error. */
+      try
+      {
+        skill.id = reader.get_attribute_int("typeID");
+        skill.points = reader.get_attribute_int("skillpoints");
+      }
+      catch (Exception& e)
+      {
+        throw Exception(e + " in element \"row\"");
+      }
+
+      /* Fetch the level field. If it's not there, ignore the skill. */
+      char const* level = reader.get_attribute("level");
+      if (level == 0)
+      {
+        std::cout << "Warning: Ignoring skill without "
+            "\"level\" attribute: " << skill.id << std::endl;
+        continue;
+      }
+
+      try
+      {
+        skill.level = reader.get_attribute_int("level");
+      }
+      catch (Exception& e)
+      {
+        throw Exception(e + " in element \"row\"");
+      }
+      this->skills.push_back(skill);
+      this->skill_index.insert(skill.id, (int)this->skills.size() - 1);
+    }
+    else if (depth == 3 && section == SECTION_CERTS
+        && reader.is_element("row"))
+    {
+      ApiCharSheetCert cert;
+
+      try
+      {
+        cert.id = reader.get_attribute_int("certificateID");
+      }
+      catch (Exception& e)
+      {
+        throw Exception(e + " in element \"row\"");
+      }
+
+      this->certs.push_back(cert);
+      this->cert_index.insert(cert.id, (int)this->certs.size() - 1);
+    }
+    else if (depth == 4 && bonus != 0
+        && reader.is_element("augmentatorValue"))
+    {
+      *bonus = Helpers::get_double_from_string(reader.read_text());
+    }
+  }
+}
+
+/* ---------------------------------------------------------------- */
+
 void
 ApiCharSheet::parse_eveapi_tag (xmlNodePtr node)
 {
@@ -220,10 +431,8 @@ ApiCharSheet::parse_skills_tag (xmlNodePtr node)
       /* Fetch these fields. If they are not there, it's an error. */
       try
       {
-        skill.id = Helpers::get_int_from_string
-            (this->get_property(node, "typeID"));
-        skill.points = Helpers::get_int_from_string
-            (this->get_property(node, "skillpoints"));
+        skill.id = this->get_property_int(node, "typeID");
+        skill.points = this->get_property_int(node, "skillpoints");
       }
       catch (Exception& e)
       {
@@ -232,19 +441,25 @@ ApiCharSheet::parse_skills_tag (xmlNodePtr node)
 
       /* Fetch the level field. If it's not there, ignore the skill.
        * This might happen if the skill in "unpublished" (removed?). */
-      try
+      if (!xmlHasProp(node, (xmlChar const*)"level"))
       {
-        skill.level = Helpers::get_int_from_string
-            (this->get_property(node, "level"));
+        std::cout << "Warning: Ignoring skill without "
+            "\"level\" attribute: " << skill.id << std::endl;
+        continue;
+      }
 
-        /* Add skill to list. */
-        this->skills.push_back(skill);
+      try
+      {
+        skill.level = this->get_property_int(node, "level");
       }
       catch (Exception& e)
       {
-        std::cout << "Warning: Ignoring skill without "
-            "\"level\" attribute: " << skill.id << std::endl;
+        throw Exception(e + " in element \"row\"");
       }
+
+      /* Add skill to list. */
+      this->skills.push_back(skill);
+      this->skill_index.insert(skill.id, (int)this->skills.size() - 1);
     }
   }
 }
@@ -265,9 +480,9 @@ ApiCharSheet::parse_certificates_tag (xmlNodePtr node)
 
       try
       {
-        cert.id = Helpers::get_int_from_string
-            (this->get_property(node, "certificateID"));
+        cert.id = this->get_property_int(node, "certificateID");
         this->certs.push_back(cert);
+        this->cert_index.insert(cert.id, (int)this->certs.size() - 1);
       }
       catch (Exception& e)
       {
@@ -338,6 +553,7 @@ ApiCharSheet::add_char_skill (int skill_id, int level)
     new_cskill.details = skill;
 
     this->skills.push_back(new_cskill);
+    this->skill_index.insert(skill->id, (int)this->skills.size() - 1);
     this->skills_at[level] += 1;
     this->total_sp += skill_start_sp;
   }
@@ -369,15 +585,37 @@ ApiCharSheet::add_char_skill (int skill_id, int level)
 
 /* ---------------------------------------------------------------- */
 
+void
+ApiCharSheet::rebuild_indices (void)
+{
+  this->skill_index.clear();
+  for (std::size_t i = 0; i < this->skills.size(); ++i)
+    this->skill_index.insert(this->skills[i].id, (int)i);
+
+  this->cert_index.clear();
+  this->class_grades.clear();
+  for (std::size_t i = 0; i < this->certs.size(); ++i)
+  {
+    ApiCert const* cert = this->certs[i].details;
+    int class_id = cert->class_details->id;
+    this->cert_index.insert(this->certs[i].id, (int)i);
+    if (this->class_grades.find(class_id) < cert->grade)
+      this->class_grades.set(class_id, cert->grade);
+  }
+}
+
+/* ---------------------------------------------------------------- */
+
 int
 ApiCharSheet::get_level_for_skill (int id) const
 {
-  for (std::size_t i = 0; i < this->skills.size(); ++i)
-    if (this->skills[i].id == id)
-      return this->skills[i].level;
+  int index = this->skill_index.find(id);
 
   /* Return level 0 if skill is not in the list. */
-  return 0;
+  if (index < 0)
+    return 0;
+
+  return this->skills[index].level;
 }
 
 /* ---------------------------------------------------------------- */
@@ -385,11 +623,11 @@ ApiCharSheet::get_level_for_skill (int id) const
 ApiCharSheetSkill*
 ApiCharSheet::get_skill_for_id (int id)
 {
-  for (std::size_t i = 0; i < this->skills.size(); ++i)
-    if (this->skills[i].id == id)
-      return &this->skills[i];
+  int index = this->skill_index.find(id);
+  if (index < 0)
+    return 0;
 
-  return 0;
+  return &this->skills[index];
 }
 
 /* ---------------------------------------------------------------- */
@@ -397,11 +635,11 @@ ApiCharSheet::get_skill_for_id (int id)
 ApiCharSheetCert*
 ApiCharSheet::get_cert_for_id (int id)
 {
-  for (std::size_t i = 0; i < this->certs.size(); ++i)
-    if (this->certs[i].id == id)
-      return &this->certs[i];
+  int index = this->cert_index.find(id);
+  if (index < 0)
+    return 0;
 
-  return 0;
+  return &this->certs[index];
 }
 
 /* ---------------------------------------------------------------- */
@@ -409,14 +647,9 @@ ApiCharSheet::get_cert_for_id (int id)
 int
 ApiCharSheet::get_grade_for_class (int class_id) const
 {
-  int grade = 0;
-  for (std::size_t i = 0; i < this->certs.size(); ++i)
-  {
-    ApiCert const* cert = this->certs[i].details;
-    ApiCertClass const* cclass = cert->class_details;
-    if (cclass->id == class_id && cert->grade > grade)
-      grade = this->certs[i].details->grade;
-  }
+  int grade = this->class_grades.find(class_id);
+  if (grade < 0)
+    return 0;
 
   return grade;
 }
@@ -427,13 +660,22 @@ unsigned int
 ApiCharSheet::get_spph_for_skill (ApiSkill const* skill,
     ApiCharAttribs const& attribs)
 {
-  double pri;
-  double sec;
-
   if (skill == 0)
     return 0;
 
-  switch (skill->primary)
+  return ApiCharSheet::calc_spph(skill->primary, skill->secondary, attribs);
+}
+
+/* ---------------------------------------------------------------- */
+
+unsigned int
+ApiCharSheet::calc_spph (ApiAttrib primary, ApiAttrib secondary,
+    ApiCharAttribs const& attribs)
+{
+  double pri;
+  double sec;
+
+  switch (primary)
   {
     case API_ATTRIB_INTELLIGENCE: pri = attribs.intl; break;
     case API_ATTRIB_MEMORY:       pri = attribs.mem; break;
@@ -443,7 +685,7 @@ ApiCharSheet::get_spph_for_skill (ApiSkill const* skill,
     default: pri = 0.0;
   }
 
-  switch (skill->secondary)
+  switch (secondary)
   {
     case API_ATTRIB_INTELLIGENCE: sec = attribs.intl; break;
     case API_ATTRIB_MEMORY:       sec = attribs.mem; break;
@@ -503,12 +745,7 @@ ApiCharSheet::debug_dump (void)
 bool
 ApiCharSheet::is_skill_known (int id)
 {
-  for (size_t i = 0; i < skills.size(); i++)
-  {
-    if (skills[i].id == id)
-      return true;
-  }
-  return false;
+  return this->skill_index.find(id) >= 0;
 }
 
 /* ---------------------------------------------------------------- */
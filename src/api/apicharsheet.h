@@ -18,6 +18,7 @@
 #include <libxml/parser.h>
 
 #include "util/ref_ptr.h"
+#include "util/idindex.h"
 #include "net/http.h"
 #include "apibase.h"
 #include "apiskilltree.h"
@@ -88,6 +89,8 @@ class ApiCharSheet : public ApiBase
     ApiCharSheet (void);
 
     void parse_xml (void);
+    void parse_dom (char const* data, std::size_t size);
+    void parse_stream (char const* data, std::size_t size);
     void parse_eveapi_tag (xmlNodePtr node);
     void parse_result_tag (xmlNodePtr node);
     void parse_attribute_tag (xmlNodePtr node);
@@ -96,8 +99,15 @@ class ApiCharSheet : public ApiBase
     void parse_certificates_tag (xmlNodePtr node);
 
     void find_implant_bonus (xmlNodePtr node, char const* name, double& var);
+    void rebuild_indices (void);
     void debug_dump (void);
 
+  /* Index of skills and certs by ID and best grade per cert class. */
+  protected:
+    IdIndex skill_index;
+    IdIndex cert_index;
+    IdIndex class_grades;
+
   /* Publicly available collection of gathered data. */
   public:
     bool valid;
@@ -140,11 +150,11 @@ class ApiCharSheet : public ApiBase
     /* Check whether the character knows this skill */
     bool is_skill_known (int id);
 
-    /* Lookup methods for skills. This is expensive. */
+    /* Lookup methods for skills. These are hash lookups. */
     ApiCharSheetSkill* get_skill_for_id (int id);
     int get_level_for_skill (int id) const;
 
-    /* Lookup methods for certificates. This is expensive. */
+    /* Lookup methods for certificates. These are hash lookups. */
     ApiCharSheetCert* get_cert_for_id (int id);
     int get_grade_for_class (int class_id) const;
 
@@ -158,6 +168,11 @@ class ApiCharSheet : public ApiBase
     unsigned int get_spph_for_skill (ApiSkill const* skill,
         ApiCharAttribs const& attribs);
 
+    /* Calculates the SP/h for a primary and secondary attribute
+     * pair with the given attributes. This is character independent. */
+    static unsigned int calc_spph (ApiAttrib primary, ApiAttrib secondary,
+        ApiCharAttribs const& attribs);
+
     /* Generic calculation of skill start and destination SP.
      * This is character independent. */
     static int calc_start_sp (int level, int rank);
@@ -189,7 +204,7 @@ ApiCharSheet::ApiCharSheet (void) : valid(false)
 inline ApiCharSheetPtr
 ApiCharSheet::create (void)
 {
-  return ApiCharSheetPtr(new ApiCharSheet);
+  return make_ref<ApiCharSheet>();
 }
 
 inline unsigned int
@@ -0,0 +1,288 @@
+#include <algorithm>
+#include <sstream>
+#include <iostream>
+#include <glibmm/main.h>
+
+#include "util/os.h"
+#include "bits/config.h"
+#include "eveapi.h"
+#include "apischeduler.h"
+
+EveApiScheduler* EveApiScheduler::instance = 0;
+
+/* ---------------------------------------------------------------- */
+
+EveApiScheduler::EveApiScheduler (void)
+  : next_start(0), next_id(0)
+{
+}
+
+/* ---------------------------------------------------------------- */
+
+EveApiScheduler::~EveApiScheduler (void)
+{
+  this->timer.disconnect();
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+EveApiScheduler::enqueue (EveApiFetcher* fetcher)
+{
+  if (EveApiScheduler::instance == 0)
+    EveApiScheduler::instance = new EveApiScheduler;
+  EveApiScheduler::instance->add_fetcher(fetcher);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+EveApiScheduler::cancel (EveApiFetcher* fetcher)
+{
+  if (EveApiScheduler::instance != 0)
+    EveApiScheduler::instance->remove_fetcher(fetcher);
+}
+
+/* ---------------------------------------------------------------- */
+
+EveApiSchedulerStats
+EveApiScheduler::get_stats (void)
+{
+  if (EveApiScheduler::instance == 0)
+    return EveApiSchedulerStats();
+  return EveApiScheduler::instance->stats;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+EveApiScheduler::unload (void)
+{
+  if (EveApiScheduler::instance == 0)
+    return;
+
+  EveApiSchedulerStats stats = EveApiScheduler::get_stats();
+  uint64_t started = stats.completed + stats.active;
+  std::cout << "API scheduler: " << stats.requests << " requests, "
+      << stats.coalesced << " coalesced, "
+      << (started == 0 ? 0 : stats.wait_total / started)
+      << " ms average queue wait (max " << stats.wait_max << " ms), "
+      << (stats.completed == 0 ? 0 : stats.latency_total / stats.completed)
+      << " ms average latency (max " << stats.latency_max << " ms)"
+      << std::endl;
+
+  delete EveApiScheduler::instance;
+  EveApiScheduler::instance = 0;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+EveApiScheduler::add_fetcher (EveApiFetcher* fetcher)
+{
+  std::stringstream ss;
+  ss << fetcher->auth.user_id << ":" << fetcher->auth.char_id
+      << ":" << fetcher->type;
+  std::string key = ss.str();
+
+  /* Coalesce with a queued or running request for the same document. */
+  for (std::list<Request>::iterator iter = this->requests.begin();
+      iter != this->requests.end(); iter++)
+  {
+    if (iter->done || iter->key != key)
+      continue;
+
+    if (std::find(iter->fetchers.begin(), iter->fetchers.end(), fetcher)
+        == iter->fetchers.end())
+      iter->fetchers.push_back(fetcher);
+    this->stats.coalesced += 1;
+    return;
+  }
+
+  Request req;
+  req.id = this->next_id++;
+  req.key = key;
+  req.user_id = fetcher->auth.user_id;
+  req.fetchers.push_back(fetcher);
+  req.queued_ms = OS::monotonic_ms();
+  req.started_ms = 0;
+  req.active = false;
+  req.done = false;
+  this->requests.push_back(req);
+
+  this->stats.requests += 1;
+  this->stats.queued += 1;
+  this->schedule();
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+EveApiScheduler::remove_fetcher (EveApiFetcher* fetcher)
+{
+  std::list<Request>::iterator iter = this->requests.begin();
+  while (iter != this->requests.end())
+  {
+    iter->fetchers.erase(std::remove(iter->fetchers.begin(),
+        iter->fetchers.end(), fetcher), iter->fetchers.end());
+
+    /* Queued requests nobody is interested in anymore are dropped. */
+    if (!iter->active && !iter->done && iter->fetchers.empty())
+    {
+      this->stats.queued -= 1;
+      iter = this->requests.erase(iter);
+    }
+    else
+      iter++;
+  }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+EveApiScheduler::schedule (void)
+{
+  std::size_t max_active = (std::size_t)std::max(1, Config::conf.get_value
+      ("network.api_max_requests")->get_int());
+
+  uint64_t now = OS::monotonic_ms();
+  uint64_t wait = 0;
+  for (std::list<Request>::iterator iter = this->requests.begin();
+      iter != this->requests.end(); iter++)
+  {
+    if (this->stats.active >= max_active)
+      break;
+    if (iter->active || iter->done)
+      continue;
+
+    uint64_t ready = std::max(this->next_start, this->key_next[iter->user_id]);
+    if (ready > now)
+    {
+      if (wait == 0 || ready - now < wait)
+        wait = ready - now;
+      continue;
+    }
+
+    this->next_start = now + API_SCHEDULER_STAGGER_MS;
+    this->key_next[iter->user_id] = now + API_SCHEDULER_KEY_INTERVAL_MS;
+    this->start_request(*iter);
+  }
+
+  /* Remove requests that failed to start. */
+  std::list<Request>::iterator iter = this->requests.begin();
+  while (iter != this->requests.end())
+  {
+    if (iter->done && !iter->active)
+      iter = this->requests.erase(iter);
+    else
+      iter++;
+  }
+
+  /* Come back once the next request may be started. */
+  this->timer.disconnect();
+  if (wait > 0)
+    this->timer = Glib::signal_timeout().connect(sigc::ptr_fun
+        (&EveApiScheduler::on_timer), (unsigned int)wait);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+EveApiScheduler::start_request (Request& req)
+{
+  AsyncHttp* http = req.fetchers.front()->setup_fetcher();
+  this->stats.queued -= 1;
+  if (http == 0)
+  {
+    /* Invalid document type. This has been reported. */
+    for (std::size_t i = 0; i < req.fetchers.size(); ++i)
+      req.fetchers[i]->busy = false;
+    req.fetchers.clear();
+    req.done = true;
+    return;
+  }
+
+  req.active = true;
+  req.started_ms = OS::monotonic_ms();
+  uint64_t wait = req.started_ms - req.queued_ms;
+  this->stats.wait_total += wait;
+  this->stats.wait_max = std::max(this->stats.wait_max, wait);
+  this->stats.active += 1;
+
+  http->signal_done().connect(sigc::bind(sigc::ptr_fun
+      (&EveApiScheduler::on_reply), req.id));
+  http->async_request();
+}
+
+/* ---------------------------------------------------------------- */
+
+EveApiScheduler::Request*
+EveApiScheduler::find_request (unsigned int id)
+{
+  for (std::list<Request>::iterator iter = this->requests.begin();
+      iter != this->requests.end(); iter++)
+    if (iter->id == id)
+      return &*iter;
+  return 0;
+}
+
+/* ---------------------------------------------------------------- */
+
+bool
+EveApiScheduler::on_timer (void)
+{
+  if (EveApiScheduler::instance != 0)
+    EveApiScheduler::instance->schedule();
+  return false;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+EveApiScheduler::on_reply (AsyncHttpData data, unsigned int id)
+{
+  EveApiScheduler* self = EveApiScheduler::instance;
+  if (self == 0)
+    return;
+
+  Request* req = self->find_request(id);
+  if (req == 0)
+    return;
+
+  uint64_t latency = OS::monotonic_ms() - req->started_ms;
+  self->stats.latency_total += latency;
+  self->stats.latency_max = std::max(self->stats.latency_max, latency);
+  self->stats.completed += 1;
+  self->stats.active -= 1;
+  req->done = true;
+
+  /* Deliver to one fetcher at a time. Callbacks may enqueue new
+   * requests or destroy fetchers, which removes them from the list. */
+  while (true)
+  {
+    self = EveApiScheduler::instance;
+    req = (self == 0 ? 0 : self->find_request(id));
+    if (req == 0 || req->fetchers.empty())
+      break;
+
+    EveApiFetcher* fetcher = req->fetchers.front();
+    req->fetchers.erase(req->fetchers.begin());
+    fetcher->async_reply(data);
+  }
+
+  self = EveApiScheduler::instance;
+  if (self == 0)
+    return;
+
+  for (std::list<Request>::iterator iter = self->requests.begin();
+      iter != self->requests.end(); iter++)
+  {
+    if (iter->id == id)
+    {
+      self->requests.erase(iter);
+      break;
+    }
+  }
+
+  self->schedule();
+}
@@ -0,0 +1,119 @@
+/*
+ * This file is part of GtkEveMon.
+ *
+ * GtkEveMon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GtkEveMon. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef API_SCHEDULER_HEADER
+#define API_SCHEDULER_HEADER
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <sigc++/connection.h>
+
+#include "net/asynchttp.h"
+
+/* Minimum time in milli seconds between two requests. */
+#define API_SCHEDULER_STAGGER_MS 100
+/* Minimum time in milli seconds between two requests for one API key. */
+#define API_SCHEDULER_KEY_INTERVAL_MS 500
+
+class EveApiFetcher;
+
+/* ---------------------------------------------------------------- */
+
+struct EveApiSchedulerStats
+{
+  std::size_t queued;
+  std::size_t active;
+  unsigned int requests;
+  unsigned int coalesced;
+  unsigned int completed;
+  /* Time in milli seconds requests waited in the queue. */
+  uint64_t wait_total;
+  uint64_t wait_max;
+  /* Time in milli seconds from starting to finishing requests. */
+  uint64_t latency_total;
+  uint64_t latency_max;
+
+  EveApiSchedulerStats (void);
+};
+
+/* ---------------------------------------------------------------- */
+
+/*
+ * Central scheduler for asynchronous API requests. Requests for the
+ * same API key, character and document that are queued or running are
+ * coalesced into one request, and the result is delivered to all
+ * fetchers. At most "network.api_max_requests" requests are running at
+ * once, consecutive requests are staggered and requests for one API key
+ * are rate limited. Must only be used from the main thread.
+ */
+class EveApiScheduler
+{
+  private:
+    struct Request
+    {
+      unsigned int id;
+      std::string key;
+      std::string user_id;
+      std::vector<EveApiFetcher*> fetchers;
+      uint64_t queued_ms;
+      uint64_t started_ms;
+      bool active;
+      bool done;
+    };
+
+    static EveApiScheduler* instance;
+
+    std::list<Request> requests;
+    std::map<std::string, uint64_t> key_next;
+    uint64_t next_start;
+    unsigned int next_id;
+    sigc::connection timer;
+    EveApiSchedulerStats stats;
+
+  private:
+    EveApiScheduler (void);
+    ~EveApiScheduler (void);
+
+    void add_fetcher (EveApiFetcher* fetcher);
+    void remove_fetcher (EveApiFetcher* fetcher);
+    void schedule (void);
+    void start_request (Request& req);
+    Request* find_request (unsigned int id);
+    static bool on_timer (void);
+    static void on_reply (AsyncHttpData data, unsigned int id);
+
+  public:
+    /* Queues an asynchronous request for the fetcher. */
+    static void enqueue (EveApiFetcher* fetcher);
+    /* Removes the fetcher from all requests. The fetcher is not
+     * notified anymore. Called when fetchers are destroyed. */
+    static void cancel (EveApiFetcher* fetcher);
+    /* Returns queue depth and latency statistics. */
+    static EveApiSchedulerStats get_stats (void);
+    /* Prints the statistics and drops all requests. Replies to
+     * running requests are ignored. */
+    static void unload (void);
+};
+
+/* ---------------------------------------------------------------- */
+
+inline
+EveApiSchedulerStats::EveApiSchedulerStats (void)
+  : queued(0), active(0), requests(0), coalesced(0), completed(0),
+    wait_total(0), wait_max(0), latency_total(0), latency_max(0)
+{
+}
+
+#endif /* API_SCHEDULER_HEADER */
@@ -1,6 +1,5 @@
 #include <iostream>
 
-#include "util/helpers.h"
 #include "xml.h"
 #include "evetime.h"
 #include "apiskillqueue.h"
@@ -8,6 +7,13 @@
 void
 ApiSkillQueue::set_api_data (EveApiData const& data)
 {
+  /* Keep the parsed queue if the document did not change. */
+  if (this->take_unchanged(data, this->valid))
+  {
+    this->enforce_cache_time(API_SKILL_QUEUE_MIN_CACHE_TIME);
+    return;
+  }
+
   this->valid = false;
   this->queue.clear();
 
@@ -55,14 +61,75 @@ void
 ApiSkillQueue::parse_xml (void)
 {
   std::cout << "Parsing XML: SkillQueue.xml ..." << std::endl;
-  XmlDocumentPtr xml = XmlDocument::create
-      (&this->http_data->data[0], this->http_data->data.size());
+  char const* data = &this->http_data->data[0];
+  std::size_t size = this->http_data->data.size();
+  if (ApiBase::use_streaming_parser())
+    this->parse_stream(data, size);
+  else
+    this->parse_dom(data, size);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+ApiSkillQueue::parse_dom (char const* data, std::size_t size)
+{
+  XmlDocumentPtr xml = XmlDocument::create(data, size);
   xmlNodePtr root = xml->get_root_element();
   this->parse_eveapi_tag(root);
 }
 
 /* ---------------------------------------------------------------- */
 
+void
+ApiSkillQueue::parse_stream (char const* data, std::size_t size)
+{
+  XmlReader reader(data, size);
+  if (!reader.next_element() || !reader.is_element("eveapi"))
+    throw Exception("Invalid XML root. Expecting <eveapi> node.");
+
+  /* Depth of the deepest element on the current path that is parsed. */
+  int matched = 0;
+  while (reader.next_element())
+  {
+    int depth = reader.get_depth();
+    if (depth > matched + 1)
+      continue;
+    matched = depth - 1;
+
+    if (depth == 1)
+    {
+      /* Let the base class know of some fields. */
+      this->check_element(reader);
+      if (reader.is_element("result"))
+        matched = 1;
+    }
+    else if (depth == 2 && reader.is_element("rowset"))
+    {
+      if (reader.get_attribute_string("name") == "skillqueue")
+        matched = 2;
+    }
+    else if (depth == 3 && reader.is_element("row"))
+    {
+      ApiSkillQueueItem item;
+      item.start_time = reader.get_attribute_string("startTime");
+      item.end_time = reader.get_attribute_string("endTime");
+      item.queue_pos = reader.get_attribute_int("queuePosition");
+      item.skill_id = reader.get_attribute_int("typeID");
+      item.to_level = reader.get_attribute_int("level");
+      item.start_sp = reader.get_attribute_int("startSP");
+      item.end_sp = reader.get_attribute_int("endSP");
+      /* Paused queue results in empty start/end-time. This yields -1 here. */
+      item.start_time_t = EveTime::get_time_for_string(item.start_time);
+      item.end_time_t = EveTime::get_time_for_string(item.end_time);
+
+      this->queue.push_back(item);
+    }
+  }
+}
+
+/* ---------------------------------------------------------------- */
+
 void
 ApiSkillQueue::parse_eveapi_tag (xmlNodePtr node)
 {
@@ -117,20 +184,14 @@ ApiSkillQueue::parse_queue_rowset (xmlNodePtr node)
 
     if (!xmlStrcmp(node->name, (xmlChar const*)"row"))
     {
-      std::string pos = this->get_property(node, "queuePosition");
-      std::string type_id = this->get_property(node, "typeID");
-      std::string level = this->get_property(node, "level");
-      std::string startsp = this->get_property(node, "startSP");
-      std::string endsp = this->get_property(node, "endSP");
-
       ApiSkillQueueItem item;
       item.start_time = this->get_property(node, "startTime");
       item.end_time = this->get_property(node, "endTime");
-      item.queue_pos = Helpers::get_int_from_string(pos);
-      item.skill_id = Helpers::get_int_from_string(type_id);
-      item.to_level = Helpers::get_int_from_string(level);
-      item.start_sp = Helpers::get_int_from_string(startsp);
-      item.end_sp = Helpers::get_int_from_string(endsp);
+      item.queue_pos = this->get_property_int(node, "queuePosition");
+      item.skill_id = this->get_property_int(node, "typeID");
+      item.to_level = this->get_property_int(node, "level");
+      item.start_sp = this->get_property_int(node, "startSP");
+      item.end_sp = this->get_property_int(node, "endSP");
       /* Paused queue results in empty start/end-time. This yields -1 here. */
       item.start_time_t = EveTime::get_time_for_string(item.start_time);
       item.end_time_t = EveTime::get_time_for_string(item.end_time);
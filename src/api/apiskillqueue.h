@@ -49,6 +49,8 @@ class ApiSkillQueue : public ApiBase
     ApiSkillQueue (void);
 
     void parse_xml (void);
+    void parse_dom (char const* data, std::size_t size);
+    void parse_stream (char const* data, std::size_t size);
     void parse_eveapi_tag (xmlNodePtr node);
     void parse_result_tag (xmlNodePtr node);
     void parse_queue_rowset (xmlNodePtr node);
@@ -92,7 +94,7 @@ ApiSkillQueue::ApiSkillQueue (void)
 inline ApiSkillQueuePtr
 ApiSkillQueue::create (void)
 {
-  return ApiSkillQueuePtr(new ApiSkillQueue);
+  return make_ref<ApiSkillQueue>();
 }
 
 #endif /* API_SKILL_QUEUE_HEADER */
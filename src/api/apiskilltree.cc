@@ -2,6 +2,8 @@
 #include <fstream>
 #include <iostream>
 #include <vector>
+#include <algorithm>
+#include <cctype>
 
 #include "util/helpers.h"
 #include "util/exception.h"
@@ -12,6 +14,19 @@
 #define SKILLTREE_FN "SkillTree.xml"
 
 ApiSkillTreePtr ApiSkillTree::instance;
+std::list<ApiSkillTreePtr> ApiSkillTree::retired;
+
+/* Orders positions in the list of parsed skills by skill ID. */
+class ApiSkillIdLess
+{
+  private:
+    ApiSkillList const& skills;
+
+  public:
+    ApiSkillIdLess (ApiSkillList const& skills) : skills(skills) {}
+    bool operator() (std::size_t a, std::size_t b) const
+    { return this->skills[a].id < this->skills[b].id; }
+};
 
 /* ---------------------------------------------------------------- */
 
@@ -19,10 +34,7 @@ ApiSkillTreePtr
 ApiSkillTree::request (void)
 {
   if (ApiSkillTree::instance.get() == 0)
-  {
-    ApiSkillTree::instance = ApiSkillTreePtr(new ApiSkillTree);
-    ApiSkillTree::instance->refresh();
-  }
+    ApiSkillTree::refresh();
 
   return ApiSkillTree::instance;
 }
@@ -40,7 +52,7 @@ ApiSkillTree::refresh (void)
 {
   try
   {
-    this->parse_xml(this->get_filename());
+    ApiSkillTree::publish(ApiSkillTree::load());
     return;
   }
   catch (Exception& e)
@@ -55,8 +67,29 @@ ApiSkillTree::refresh (void)
 
 /* ---------------------------------------------------------------- */
 
+ApiSkillTreePtr
+ApiSkillTree::load (void)
+{
+  ApiSkillTreePtr tree = make_ref<ApiSkillTree>();
+  tree->parse_xml(ApiSkillTree::get_filename());
+  return tree;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+ApiSkillTree::publish (ApiSkillTreePtr tree)
+{
+  /* Keep the previous tree, there may be pointers to its skills. */
+  if (ApiSkillTree::instance.get() != 0)
+    ApiSkillTree::retired.push_back(ApiSkillTree::instance);
+  ApiSkillTree::instance = tree;
+}
+
+/* ---------------------------------------------------------------- */
+
 std::string
-ApiSkillTree::get_filename (void) const
+ApiSkillTree::get_filename (void)
 {
   return Config::get_conf_dir() + "/" SKILLTREE_FN;
 }
@@ -66,17 +99,368 @@ ApiSkillTree::get_filename (void) const
 void
 ApiSkillTree::parse_xml (std::string const& filename)
 {
-  /* Try to read the document. */
-  XmlDocumentPtr xml = XmlDocument::create_from_file(filename);
-  xmlNodePtr root = xml->get_root_element();
+  /* Use the binary cache if it was created from this very file.
+   * Otherwise the document is parsed from the mapped file. */
+  TreeCacheSource source;
+  source.open(filename);
+  if (this->read_cache(filename + ".cache", source))
+    return;
 
   std::cout << "Parsing XML: " SKILLTREE_FN "... " << std::flush;
 
+  if (ApiBase::use_streaming_parser())
+    this->parse_stream(source.get_data(), source.get_size());
+  else
+    this->parse_dom(source.get_data(), source.get_size());
+  std::cout << this->skills.size() << " skills." << std::endl;
+
+  this->write_cache(filename + ".cache", source.get_key());
+}
+
+/* ---------------------------------------------------------------- */
+
+bool
+ApiSkillTree::read_cache (std::string const& filename,
+    TreeCacheSource& source)
+{
+  TreeCacheReader cache;
+  if (!cache.open(filename, source))
+    return false;
+
+  std::cout << "Reading cache: " SKILLTREE_FN "... " << std::flush;
+
+  this->parse_skills.clear();
+  this->parse_deps.clear();
+  this->parse_ranges.clear();
+  this->groups.clear();
+
+  try
+  {
+    int num_groups = cache.read_int();
+    for (int i = 0; i < num_groups; ++i)
+    {
+      ApiSkillGroup group;
+      group.id = cache.read_int();
+      group.name = cache.read_string();
+      this->groups.insert(std::make_pair(group.id, group));
+    }
+
+    int num_skills = cache.read_int();
+    for (int i = 0; i < num_skills; ++i)
+    {
+      ApiSkill skill;
+      skill.id = cache.read_int();
+      skill.group = cache.read_int();
+      skill.rank = cache.read_int();
+      skill.published = cache.read_int();
+      skill.name = cache.read_string();
+      skill.desc = cache.read_string();
+      skill.primary = (ApiAttrib)cache.read_int();
+      skill.secondary = (ApiAttrib)cache.read_int();
+
+      std::size_t deps_begin = this->parse_deps.size();
+      int num_deps = cache.read_int();
+      for (int j = 0; j < num_deps; ++j)
+      {
+        int dep_id = cache.read_int();
+        int dep_level = cache.read_int();
+        this->parse_deps.push_back(std::make_pair(dep_id, dep_level));
+      }
+
+      this->parse_skills.push_back(skill);
+      this->parse_ranges.push_back(std::make_pair
+          (deps_begin, this->parse_deps.size()));
+    }
+
+    if (!cache.at_end())
+      throw Exception("Trailing data in tree cache");
+  }
+  catch (Exception& e)
+  {
+    std::cout << e << std::endl;
+    this->groups.clear();
+    return false;
+  }
+
+  this->compile_skills();
+  std::cout << this->skills.size() << " skills." << std::endl;
+  return true;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+ApiSkillTree::write_cache (std::string const& filename,
+    TreeCacheKey const& key)
+{
+  TreeCacheWriter cache;
+
+  cache.write_int((int)this->groups.size());
+  for (ApiSkillGroupMap::const_iterator iter = this->groups.begin();
+      iter != this->groups.end(); iter++)
+  {
+    cache.write_int(iter->second.id);
+    cache.write_string(iter->second.name);
+  }
+
+  cache.write_int((int)this->skills.size());
+  for (std::size_t i = 0; i < this->skills.size(); ++i)
+  {
+    ApiSkill const& skill = this->skills[i];
+    cache.write_int(skill.id);
+    cache.write_int(skill.group);
+    cache.write_int(skill.rank);
+    cache.write_int(skill.published);
+    cache.write_string(skill.name);
+    cache.write_string(skill.desc);
+    cache.write_int((int)skill.primary);
+    cache.write_int((int)skill.secondary);
+
+    cache.write_int((int)skill.deps.size());
+    for (std::size_t j = 0; j < skill.deps.size(); ++j)
+    {
+      cache.write_int(skill.deps[j].first);
+      cache.write_int(skill.deps[j].second);
+    }
+  }
+
+  try
+  {
+    cache.save(filename, key);
+  }
+  catch (Exception& e)
+  {
+    std::cout << "Error writing skill tree cache: " << e << std::endl;
+  }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+ApiSkillTree::compile_skills (void)
+{
+  /* Sort the parsed skills by ID. The first of duplicate IDs is used. */
+  std::vector<std::size_t> order(this->parse_skills.size());
+  for (std::size_t i = 0; i < order.size(); ++i)
+    order[i] = i;
+  std::stable_sort(order.begin(), order.end(),
+      ApiSkillIdLess(this->parse_skills));
+
+  /* Copy skills and their deps in that order into the new arrays. */
+  ApiSkillList skills;
+  ApiSkillDepsList deps;
+  std::vector<std::pair<std::size_t, std::size_t> > ranges;
+  skills.reserve(order.size());
+  deps.reserve(this->parse_deps.size());
+  for (std::size_t i = 0; i < order.size(); ++i)
+  {
+    ApiSkill const& skill = this->parse_skills[order[i]];
+    if (!skills.empty() && skills.back().id == skill.id)
+      continue;
+
+    std::pair<std::size_t, std::size_t> range = this->parse_ranges[order[i]];
+    ranges.push_back(std::make_pair(deps.size(), range.second - range.first));
+    deps.insert(deps.end(), this->parse_deps.begin() + range.first,
+        this->parse_deps.begin() + range.second);
+    skills.push_back(skill);
+  }
+
+  /* Deps are referenced once the array doesn't change anymore.
+   * Of several skills with the same name, the lowest ID is used. */
+  this->skill_index.clear();
+  this->name_index.clear();
+  this->folded_name_index.clear();
+  for (std::size_t i = 0; i < skills.size(); ++i)
+  {
+    skills[i].deps = ApiSkillDeps(deps.data() + ranges[i].first,
+        ranges[i].second);
+    this->skill_index.insert(skills[i].id, (int)i);
+    this->name_index.insert(std::make_pair(skills[i].name, (int)i));
+    this->folded_name_index.insert(std::make_pair
+        (this->fold_name(skills[i].name), (int)i));
+  }
+
+  this->skills.swap(skills);
+  this->deps.swap(deps);
+
+  ApiSkillList().swap(this->parse_skills);
+  ApiSkillDepsList().swap(this->parse_deps);
+  this->parse_ranges.clear();
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+ApiSkillTree::parse_dom (char const* data, std::size_t size)
+{
+  XmlDocumentPtr xml = XmlDocument::create(data, size);
+  xmlNodePtr root = xml->get_root_element();
+
   /* Document was parsed. Reset information. */
-  this->skills.clear();
+  this->parse_skills.clear();
+  this->parse_deps.clear();
+  this->parse_ranges.clear();
   this->groups.clear();
   this->parse_eveapi_tag(root);
-  std::cout << this->skills.size() << " skills." << std::endl;
+  this->compile_skills();
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+ApiSkillTree::parse_stream (char const* data, std::size_t size)
+{
+  XmlReader reader(data, size);
+  if (!reader.next_element() || !reader.is_element("eveapi"))
+    throw Exception("Invalid tag. Expecting <eveapi> node");
+
+  this->parse_skills.clear();
+  this->parse_deps.clear();
+  this->parse_ranges.clear();
+  this->groups.clear();
+
+  /* The skill being parsed. It's added once the next one starts. */
+  ApiSkill skill;
+  bool has_skill = false;
+  std::size_t deps_begin = 0;
+  std::map<std::string, int> bonus_data;
+  enum { ROWSET_OTHER, ROWSET_DEPS, ROWSET_BONUS } rowset = ROWSET_OTHER;
+  std::string primary;
+  std::string secondary;
+
+  /* Depth of the deepest element on the current path that is parsed. */
+  int matched = 0;
+  while (reader.next_element())
+  {
+    int depth = reader.get_depth();
+    if (depth > matched + 1)
+      continue;
+    matched = depth - 1;
+
+    if (depth < 6 && has_skill)
+    {
+      this->set_attribute(skill.primary, primary);
+      this->set_attribute(skill.secondary, secondary);
+      this->add_parsed_skill(skill, deps_begin);
+      has_skill = false;
+    }
+
+    if (depth == 1 && reader.is_element("result"))
+      matched = 1;
+    else if ((depth == 2 || depth == 4) && reader.is_element("rowset"))
+      matched = depth;
+    else if (depth == 3 && reader.is_element("row"))
+    {
+      /* Skill group. */
+      ApiSkillGroup group;
+      group.name = reader.get_attribute_string("groupName");
+      group.id = reader.get_attribute_int("groupID");
+      this->groups.insert(std::make_pair(group.id, group));
+      matched = 3;
+    }
+    else if (depth == 5 && reader.is_element("row"))
+    {
+      skill = ApiSkill();
+      skill.name = reader.get_attribute_string("typeName");
+      skill.group = reader.get_attribute_int("groupID");
+      skill.id = reader.get_attribute_int("typeID");
+      skill.published = reader.get_attribute_int("published");
+      skill.rank = 0;
+      skill.primary = API_ATTRIB_UNKNOWN;
+      skill.secondary = API_ATTRIB_UNKNOWN;
+      primary.clear();
+      secondary.clear();
+      deps_begin = this->parse_deps.size();
+      has_skill = true;
+      matched = 5;
+    }
+    else if (depth == 6)
+    {
+      if (reader.is_element("description"))
+        skill.desc = reader.read_text();
+      else if (reader.is_element("rank"))
+        skill.rank = Helpers::get_int_from_string(reader.read_text());
+      else if (reader.is_element("requiredAttributes"))
+      {
+        rowset = ROWSET_OTHER;
+        matched = 6;
+      }
+      else if (reader.is_element("rowset"))
+      {
+        std::string name = reader.get_attribute_string("name");
+        if (name == "requiredSkills")
+          rowset = ROWSET_DEPS;
+        else if (name == "skillBonusCollection")
+        {
+          rowset = ROWSET_BONUS;
+          bonus_data.clear();
+        }
+        else
+          rowset = ROWSET_OTHER;
+        matched = 6;
+      }
+    }
+    else if (depth == 7)
+    {
+      if (rowset == ROWSET_DEPS && reader.is_element("row"))
+      {
+        int type_id = reader.get_attribute_int("typeID");
+        int level = reader.get_attribute_int("skillLevel");
+        this->parse_deps.push_back(std::make_pair(type_id, level));
+      }
+      else if (rowset == ROWSET_BONUS && reader.is_element("row"))
+      {
+        /* Other bonus values are not always integers. */
+        std::string type = reader.get_attribute_string("bonusType");
+        if (type.compare(0, 13, "requiredSkill") == 0)
+          this->add_bonus_requirement(bonus_data, type,
+              reader.get_attribute_int("bonusValue"));
+      }
+      else if (reader.is_element("primaryAttribute"))
+        primary = reader.read_text();
+      else if (reader.is_element("secondaryAttribute"))
+        secondary = reader.read_text();
+    }
+  }
+
+  if (has_skill)
+  {
+    this->set_attribute(skill.primary, primary);
+    this->set_attribute(skill.secondary, secondary);
+    this->add_parsed_skill(skill, deps_begin);
+  }
+
+  this->compile_skills();
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+ApiSkillTree::add_parsed_skill (ApiSkill const& skill,
+    std::size_t deps_begin)
+{
+  this->parse_skills.push_back(skill);
+  this->parse_ranges.push_back(std::make_pair
+      (deps_begin, this->parse_deps.size()));
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+ApiSkillTree::add_bonus_requirement (std::map<std::string, int>& data,
+    std::string const& type, int value)
+{
+  data[type] = value;
+  std::string suffix = type.substr(type.size() - 5, type.size());
+  std::string basename = type.substr(0, type.size() - 5);
+  // check whether the other value was already inserted
+  if(data.count(type + "Level") == 1 || data.count(basename) == 1) {
+    if(suffix == "Level") {
+      this->parse_deps.push_back(std::make_pair(data[basename], value));
+    } else {
+      this->parse_deps.push_back(std::make_pair(value, data[type + "Level"]));
+    }
+  }
 }
 
 /* ---------------------------------------------------------------- */
@@ -181,10 +565,11 @@ ApiSkillTree::parse_skills_rowset (xmlNodePtr node)
       skill.primary = API_ATTRIB_UNKNOWN;
       skill.secondary = API_ATTRIB_UNKNOWN;
 
+      std::size_t deps_begin = this->parse_deps.size();
       this->parse_skills_row(skill, node->children);
 
       //std::cout << "Inserting skill:   " << skill.name << std::endl;
-      this->skills.insert(std::make_pair(skill.id, skill));
+      this->add_parsed_skill(skill, deps_begin);
     }
   }
 }
@@ -204,11 +589,11 @@ ApiSkillTree::parse_skills_row (ApiSkill& skill, xmlNodePtr node)
 
     if (!xmlStrcmp(node->name, (xmlChar const*)"rowset")
         && this->get_property(node, "name") == "requiredSkills")
-      this->parse_skill_requirements(skill, node->children);
+      this->parse_skill_requirements(node->children);
 
     if (!xmlStrcmp(node->name, (xmlChar const*)"rowset")
         && this->get_property(node, "name") == "skillBonusCollection")
-      this->parse_extra_skill_requirements(skill, node->children);
+      this->parse_extra_skill_requirements(node->children);
 
     if (!xmlStrcmp(node->name, (xmlChar const*)"requiredAttributes"))
       this->parse_skill_attribs(skill, node->children);
@@ -218,7 +603,7 @@ ApiSkillTree::parse_skills_row (ApiSkill& skill, xmlNodePtr node)
 /* ---------------------------------------------------------------- */
 
 void
-ApiSkillTree::parse_skill_requirements (ApiSkill& skill, xmlNodePtr node)
+ApiSkillTree::parse_skill_requirements (xmlNodePtr node)
 {
   for (; node != 0; node = node->next)
   {
@@ -228,7 +613,7 @@ ApiSkillTree::parse_skill_requirements (ApiSkill& skill, xmlNodePtr node)
       {
         int type_id = this->get_property_int(node, "typeID");
         int level = this->get_property_int(node, "skillLevel");
-        skill.deps.push_back(std::make_pair(type_id, level));
+        this->parse_deps.push_back(std::make_pair(type_id, level));
       }
     }
   }
@@ -237,7 +622,7 @@ ApiSkillTree::parse_skill_requirements (ApiSkill& skill, xmlNodePtr node)
 /* ---------------------------------------------------------------- */
 
 void
-ApiSkillTree::parse_extra_skill_requirements (ApiSkill& skill, xmlNodePtr node)
+ApiSkillTree::parse_extra_skill_requirements (xmlNodePtr node)
 {
   std::map<std::string,int> data;
   for (; node != 0; node = node->next)
@@ -246,19 +631,11 @@ ApiSkillTree::parse_extra_skill_requirements (ApiSkill& skill, xmlNodePtr node)
     {
       if (!xmlStrcmp(node->name, (xmlChar const*)"row"))
       {
-        std::string bonusType = this->get_property(node, "bonusType");
-        int value = this->get_property_int(node, "bonusValue");
-        data[bonusType] = value;
-        std::string suffix = bonusType.substr(bonusType.size() - 5, bonusType.size());
-        std::string basename = bonusType.substr(0, bonusType.size() - 5);
-        // check whether the other value was already inserted
-        if(data.count(bonusType + "Level") == 1 || data.count(basename) == 1) {
-          if(suffix == "Level") {
-            skill.deps.push_back(std::make_pair(data[basename], value));
-          } else {
-            skill.deps.push_back(std::make_pair(value, data[bonusType + "Level"]));
-          }
-        }
+        /* Other bonus values are not always integers. */
+        std::string type = this->get_property(node, "bonusType");
+        if (type.compare(0, 13, "requiredSkill") == 0)
+          this->add_bonus_requirement(data, type,
+              this->get_property_int(node, "bonusValue"));
       }
     }
   }
@@ -309,26 +686,45 @@ ApiSkillTree::set_attribute (ApiAttrib& var, std::string const& str)
 ApiSkill const*
 ApiSkillTree::get_skill_for_id (int id) const
 {
-  ApiSkillMap::const_iterator iter = this->skills.find(id);
-  if (iter == this->skills.end())
+  int index = this->skill_index.find(id);
+  if (index < 0)
     return 0;
 
-  return &iter->second;
+  return &this->skills[index];
 }
 
 /* ---------------------------------------------------------------- */
 
 ApiSkill const*
-ApiSkillTree::get_skill_for_name (std::string const& name) const
+ApiSkillTree::get_skill_for_name (std::string const& name,
+    bool ignore_case) const
 {
-  for (ApiSkillMap::const_iterator iter = this->skills.begin();
-      iter != this->skills.end(); iter++)
+  ApiSkillNameIndex::const_iterator iter;
+  if (ignore_case)
   {
-    if (iter->second.name == name)
-      return &iter->second;
+    iter = this->folded_name_index.find(this->fold_name(name));
+    if (iter == this->folded_name_index.end())
+      return 0;
   }
+  else
+  {
+    iter = this->name_index.find(name);
+    if (iter == this->name_index.end())
+      return 0;
+  }
+
+  return &this->skills[iter->second];
+}
+
+/* ---------------------------------------------------------------- */
 
-  return 0;
+std::string
+ApiSkillTree::fold_name (std::string const& name)
+{
+  std::string ret(name);
+  for (std::size_t i = 0; i < ret.size(); ++i)
+    ret[i] = (char)std::tolower((unsigned char)ret[i]);
+  return ret;
 }
 
 /* ---------------------------------------------------------------- */
@@ -385,10 +781,9 @@ int
 ApiSkillTree::count_total_skills (void) const
 {
   int count = 0;
-  for (ApiSkillMap::const_iterator iter = this->skills.begin();
-      iter != this->skills.end(); iter++)
+  for (std::size_t i = 0; i < this->skills.size(); ++i)
   {
-    if (iter->second.published)
+    if (this->skills[i].published)
       count++;
   }
   return count;
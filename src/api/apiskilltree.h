@@ -15,10 +15,14 @@
 
 #include <vector>
 #include <string>
+#include <list>
 #include <map>
+#include <unordered_map>
 
 #include "util/ref_ptr.h"
+#include "util/idindex.h"
 #include "apibase.h"
+#include "treecache.h"
 
 enum ApiAttrib
 {
@@ -40,6 +44,25 @@ struct ApiSkillGroup
 
 /* ---------------------------------------------------------------- */
 
+/* A range of skill deps in format (skill id, skill level). The deps of
+ * all skills are packed into a single array owned by the skill tree. */
+class ApiSkillDeps
+{
+  private:
+    std::pair<int, int> const* first;
+    std::size_t count;
+
+  public:
+    ApiSkillDeps (void);
+    ApiSkillDeps (std::pair<int, int> const* first, std::size_t count);
+
+    std::size_t size (void) const;
+    bool empty (void) const;
+    std::pair<int, int> const& operator[] (std::size_t index) const;
+};
+
+/* ---------------------------------------------------------------- */
+
 class ApiSkill : public ApiElement
 {
   public:
@@ -52,7 +75,7 @@ class ApiSkill : public ApiElement
     ApiAttrib primary;
     ApiAttrib secondary;
 
-    std::vector<std::pair<int, int> > deps;
+    ApiSkillDeps deps;
 
   public:
     ~ApiSkill (void) {}
@@ -64,42 +87,83 @@ class ApiSkill : public ApiElement
 
 class ApiSkillTree;
 typedef ref_ptr<ApiSkillTree> ApiSkillTreePtr;
-typedef std::map<int, ApiSkill> ApiSkillMap;
+typedef std::vector<ApiSkill> ApiSkillList;
+typedef std::vector<std::pair<int, int> > ApiSkillDepsList;
 typedef std::map<int, ApiSkillGroup> ApiSkillGroupMap;
+typedef std::unordered_map<std::string, int> ApiSkillNameIndex;
 
+/*
+ * The skill tree keeps all skills in a single array sorted by ID and
+ * indices from the skill ID and name to the array position. The deps
+ * are packed into a second array. A tree is not modified once it is
+ * published. A refresh parses a new tree and replaces the published
+ * one. Previous trees are kept, so pointers to skills stay valid for
+ * the whole runtime.
+ */
 class ApiSkillTree : public ApiBase
 {
   private:
     static ApiSkillTreePtr instance;
+    static std::list<ApiSkillTreePtr> retired;
+
+    ApiSkillDepsList deps;
+    IdIndex skill_index;
+    ApiSkillNameIndex name_index;
+    ApiSkillNameIndex folded_name_index;
+
+    /* Skills, deps and the dep range of each skill while parsing. */
+    ApiSkillList parse_skills;
+    ApiSkillDepsList parse_deps;
+    std::vector<std::pair<std::size_t, std::size_t> > parse_ranges;
 
   protected:
     ApiSkillTree (void);
     void parse_xml (std::string const& filename);
+    bool read_cache (std::string const& filename, TreeCacheSource& source);
+    void write_cache (std::string const& filename, TreeCacheKey const& key);
+    void compile_skills (void);
+    void parse_dom (char const* data, std::size_t size);
+    void parse_stream (char const* data, std::size_t size);
+    void add_parsed_skill (ApiSkill const& skill, std::size_t deps_begin);
+    void add_bonus_requirement (std::map<std::string, int>& data,
+        std::string const& type, int value);
     void parse_eveapi_tag (xmlNodePtr node);
     void parse_result_tag (xmlNodePtr node);
     void parse_groups_rowset (xmlNodePtr node);
     void parse_groups_row (xmlNodePtr node);
     void parse_skills_rowset (xmlNodePtr node);
     void parse_skills_row (ApiSkill& skill, xmlNodePtr node);
-    void parse_skill_requirements (ApiSkill& skill, xmlNodePtr node);
-    void parse_extra_skill_requirements (ApiSkill& skill, xmlNodePtr node);
+    void parse_skill_requirements (xmlNodePtr node);
+    void parse_extra_skill_requirements (xmlNodePtr node);
     void parse_skill_attribs (ApiSkill& skill, xmlNodePtr node);
 
     void set_attribute (ApiAttrib& var, std::string const& str);
+    static std::string fold_name (std::string const& name);
 
   public:
     std::string filename;
-    ApiSkillMap skills;
+    ApiSkillList skills;
     ApiSkillGroupMap groups;
 
   public:
+    /* Returns the published tree. Loads it on first use. */
     static ApiSkillTreePtr request (void);
-    void refresh (void);
-    std::string get_filename (void) const;
+    /* Loads and publishes a new tree. Exits if it cannot be loaded. */
+    static void refresh (void);
+    /* Parses the data file into a new tree. This can be used from
+     * any thread. Throws an exception on error. */
+    static ApiSkillTreePtr load (void);
+    /* Replaces the tree returned by request(). Readers of the
+     * previous tree are not affected. Call from the main thread. */
+    static void publish (ApiSkillTreePtr tree);
+    static std::string get_filename (void);
 
     int count_total_skills (void) const;
     ApiSkill const* get_skill_for_id (int id) const;
-    ApiSkill const* get_skill_for_name (std::string const& name) const;
+    /* Name lookups are hash lookups. If "ignore_case" is set, upper and
+     * lower case letters are not distinguished. */
+    ApiSkill const* get_skill_for_name (std::string const& name,
+        bool ignore_case = false) const;
     ApiSkillGroup const* get_group_for_id (int id) const;
 
     static char const* get_attrib_name (ApiAttrib const& attrib);
@@ -108,6 +172,37 @@ class ApiSkillTree : public ApiBase
 
 /* ---------------------------------------------------------------- */
 
+inline
+ApiSkillDeps::ApiSkillDeps (void)
+  : first(0), count(0)
+{
+}
+
+inline
+ApiSkillDeps::ApiSkillDeps (std::pair<int, int> const* first,
+    std::size_t count)
+  : first(first), count(count)
+{
+}
+
+inline std::size_t
+ApiSkillDeps::size (void) const
+{
+  return this->count;
+}
+
+inline bool
+ApiSkillDeps::empty (void) const
+{
+  return this->count == 0;
+}
+
+inline std::pair<int, int> const&
+ApiSkillDeps::operator[] (std::size_t index) const
+{
+  return this->first[index];
+}
+
 inline ApiElementType
 ApiSkill::get_type (void) const
 {
@@ -2,16 +2,17 @@
 #include <cerrno>
 #include <cstring>
 #include <sstream>
-#include <fstream>
 #include <iostream>
 
 #include "util/os.h"
 #include "bits/config.h"
+#include "apicache.h"
+#include "apischeduler.h"
 #include "eveapi.h"
 
 EveApiFetcher::~EveApiFetcher (void)
 {
-  this->conn_sigdone.disconnect();
+  EveApiScheduler::cancel(this);
 }
 
 /* ---------------------------------------------------------------- */
@@ -22,7 +23,7 @@ EveApiFetcher::setup_fetcher (void)
   /* Setup HTTP fetcher. */
   AsyncHttp* fetcher = AsyncHttp::create();
   Config::setup_http(fetcher, true);
-  fetcher->set_host("api.eveonline.com");
+  fetcher->set_host(Config::conf.get_value("network.api_host")->get_string());
 
   /* Setup HTTP post data. */
   std::string post_data;
@@ -99,15 +100,8 @@ EveApiFetcher::async_request (void)
 {
   std::cout << "Request XML: " << this->get_doc_name() << " ..." << std::endl;
 
-  AsyncHttp* fetcher = this->setup_fetcher();
-  if (fetcher == 0)
-    return;
-
   this->busy = true;
-
-  this->conn_sigdone = fetcher->signal_done().connect(sigc::mem_fun
-      (*this, &EveApiFetcher::async_reply));
-  fetcher->async_request();
+  EveApiScheduler::enqueue(this);
 }
 
 /* ---------------------------------------------------------------- */
@@ -169,42 +163,28 @@ EveApiFetcher::process_caching (EveApiData& data)
     }
 
     /* Write the file. */
-    std::ofstream out(file.c_str());
-    if (out.fail())
+    std::cout << "Caching XML: " << xmlname << " ..." << std::endl;
+    try
     {
-      std::cout << "Error: Couldn't write to cache file!" << std::endl;
-      return;
+      ApiCache::store(file, data.data);
+    }
+    catch (Exception& e)
+    {
+      std::cout << "Error: Couldn't write to cache file: " << e << std::endl;
     }
-    std::cout << "Caching XML: " << xmlname << " ..." << std::endl;
-    out.write(&data.data->data[0], data.data->data.size());
-    out.close();
   }
   else
   {
     /* Read unsuccessful requests from cache if available. */
-    //std::cout << "Should read from cache: " << file << std::endl;
-    bool file_exists = OS::file_exists(file.c_str());
-    if (!file_exists)
+    HttpDataPtr cached = ApiCache::load(file);
+    if (cached.get() == 0)
     {
       std::cout << "Warning: No cache file for " << xmlname << std::endl;
       return;
     }
 
-    /* Read from file. */
-    std::string input;
-    std::ifstream in(file.c_str());
-    while (!in.eof())
-    {
-      std::string line;
-      std::getline(in, line);
-      input += line;
-    }
-    in.close();
-
-    data.data = HttpData::create();
-    data.data->data.resize(input.size() + 1);
+    data.data = cached;
     data.locally_cached = true;
-    ::memcpy(&data.data->data[0], input.c_str(), input.size() + 1);
 
     std::cout << "Warning: Using " << xmlname << " from cache!" << std::endl;
   }
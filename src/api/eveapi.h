@@ -67,12 +67,13 @@ class EveApiData : public AsyncHttpData
  */
 class EveApiFetcher
 {
+  friend class EveApiScheduler;
+
   private:
     bool busy;
     EveApiAuth auth;
     EveApiDocType type;
     sigc::signal<void, EveApiData> sig_done;
-    sigc::connection conn_sigdone;
 
   protected:
     AsyncHttp* setup_fetcher (void);
@@ -89,6 +90,7 @@ class EveApiFetcher
     void set_doctype (EveApiDocType type);
 
     void request (void);
+    /* Requests are queued with the EveApiScheduler. */
     void async_request (void);
 
     sigc::signal<void, EveApiData>& signal_done (void);
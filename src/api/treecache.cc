@@ -0,0 +1,208 @@
+#include <cstring>
+#include <cerrno>
+
+#include "util/os.h"
+#include "util/helpers.h"
+#include "util/exception.h"
+#include "treecache.h"
+
+#define TREE_CACHE_MAGIC "GEMTREE"
+#define TREE_CACHE_MAGIC_LEN 8
+
+TreeCacheSource::TreeCacheSource (void)
+  : mapped(0), mapped_size(0), hashed(false)
+{
+  this->key.size = 0;
+  this->key.mtime = 0;
+  this->key.hash = 0;
+}
+
+/* ---------------------------------------------------------------- */
+
+TreeCacheSource::~TreeCacheSource (void)
+{
+  if (this->mapped != 0)
+    OS::unmap_file((void*)this->mapped, this->mapped_size);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+TreeCacheSource::open (std::string const& filename)
+{
+  if (this->mapped != 0)
+    OS::unmap_file((void*)this->mapped, this->mapped_size);
+  this->mapped = 0;
+  this->mapped_size = 0;
+  this->contents.clear();
+  this->hashed = false;
+
+  /* Gzipped files and files that cannot be mapped are read instead.
+   * This reports a missing file. */
+  this->mapped = (char const*)OS::map_file(filename.c_str(),
+      &this->mapped_size);
+  if (this->mapped != 0 && this->mapped_size >= 2
+      && (unsigned char)this->mapped[0] == 0x1f
+      && (unsigned char)this->mapped[1] == 0x8b)
+  {
+    OS::unmap_file((void*)this->mapped, this->mapped_size);
+    this->mapped = 0;
+    this->mapped_size = 0;
+  }
+  if (this->mapped == 0)
+    Helpers::read_file(filename, &this->contents, true);
+
+  this->key.size = this->get_size();
+  this->key.mtime = OS::file_mtime(filename.c_str());
+  this->key.hash = 0;
+}
+
+/* ---------------------------------------------------------------- */
+
+TreeCacheKey const&
+TreeCacheSource::get_key (void)
+{
+  if (this->hashed)
+    return this->key;
+
+  /* FNV-1a over the contents of the file. */
+  char const* data = this->get_data();
+  std::size_t size = this->get_size();
+  uint64_t hash = 14695981039346656037ull;
+  for (std::size_t i = 0; i < size; ++i)
+  {
+    hash ^= (unsigned char)data[i];
+    hash *= 1099511628211ull;
+  }
+
+  this->key.hash = hash;
+  this->hashed = true;
+  return this->key;
+}
+
+/* ================================================================ */
+
+void
+TreeCacheWriter::write_int (int value)
+{
+  this->data.append((char const*)&value, sizeof(int));
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+TreeCacheWriter::write_string (std::string const& str)
+{
+  this->write_int((int)str.size());
+  this->data.append(str);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+TreeCacheWriter::save (std::string const& cache_fn, TreeCacheKey const& key)
+{
+  int version = TREE_CACHE_VERSION;
+  std::string out(TREE_CACHE_MAGIC, TREE_CACHE_MAGIC_LEN);
+  out.append((char const*)&version, sizeof(int));
+  out.append((char const*)&key, sizeof(TreeCacheKey));
+  out.append(this->data);
+
+  std::string tmp_fn = cache_fn + ".tmp";
+  Helpers::write_file(tmp_fn, out);
+  if (!OS::rename_file(tmp_fn.c_str(), cache_fn.c_str()))
+  {
+    OS::unlink(tmp_fn.c_str());
+    throw FileException(cache_fn, ::strerror(errno));
+  }
+}
+
+/* ================================================================ */
+
+TreeCacheReader::TreeCacheReader (void)
+  : data(0), size(0), pos(0)
+{
+}
+
+/* ---------------------------------------------------------------- */
+
+TreeCacheReader::~TreeCacheReader (void)
+{
+  if (this->data != 0)
+    OS::unmap_file((void*)this->data, this->size);
+}
+
+/* ---------------------------------------------------------------- */
+
+bool
+TreeCacheReader::open (std::string const& cache_fn, TreeCacheSource& source)
+{
+  if (this->data != 0)
+    OS::unmap_file((void*)this->data, this->size);
+
+  this->size = 0;
+  this->pos = 0;
+  this->data = (char const*)OS::map_file(cache_fn.c_str(), &this->size);
+  if (this->data == 0)
+    return false;
+
+  std::size_t header_len = TREE_CACHE_MAGIC_LEN + sizeof(int)
+      + sizeof(TreeCacheKey);
+  if (this->size < header_len
+      || std::memcmp(this->data, TREE_CACHE_MAGIC, TREE_CACHE_MAGIC_LEN))
+    return false;
+  this->pos = TREE_CACHE_MAGIC_LEN;
+
+  int version;
+  TreeCacheKey cache_key;
+  this->read_raw(&version, sizeof(int));
+  this->read_raw(&cache_key, sizeof(TreeCacheKey));
+  if (version != TREE_CACHE_VERSION)
+    return false;
+
+  /* A different size means different contents. Only if just the time
+   * changed, e.g. when the same file was downloaded again, the contents
+   * are hashed to check whether the cache is still usable. */
+  TreeCacheKey const& key = source.get_stat_key();
+  if (cache_key.size != key.size)
+    return false;
+  if (cache_key.mtime == key.mtime)
+    return true;
+  return cache_key.hash == source.get_key().hash;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+TreeCacheReader::read_raw (void* buffer, std::size_t len)
+{
+  if (this->data == 0 || len > this->size - this->pos)
+    throw Exception("Unexpected end of tree cache");
+
+  std::memcpy(buffer, this->data + this->pos, len);
+  this->pos += len;
+}
+
+/* ---------------------------------------------------------------- */
+
+int
+TreeCacheReader::read_int (void)
+{
+  int value;
+  this->read_raw(&value, sizeof(int));
+  return value;
+}
+
+/* ---------------------------------------------------------------- */
+
+std::string
+TreeCacheReader::read_string (void)
+{
+  int len = this->read_int();
+  if (len < 0 || (std::size_t)len > this->size - this->pos)
+    throw Exception("Unexpected end of tree cache");
+
+  std::string str(this->data + this->pos, (std::size_t)len);
+  this->pos += (std::size_t)len;
+  return str;
+}
@@ -0,0 +1,149 @@
+/*
+ * This file is part of GtkEveMon.
+ *
+ * GtkEveMon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GtkEveMon. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TREE_CACHE_HEADER
+#define TREE_CACHE_HEADER
+
+#include <string>
+#include <ctime>
+#include <stdint.h>
+
+/* Increase whenever the format of any tree cache changes. */
+#define TREE_CACHE_VERSION 1
+
+/*
+ * The key that ties a tree cache to the XML file it was created from.
+ * The cache is only used if size and modification time of the XML file
+ * still match, or if the size and the hash of the contents match.
+ */
+struct TreeCacheKey
+{
+  uint64_t size;
+  int64_t mtime;
+  uint64_t hash;
+};
+
+/* ---------------------------------------------------------------- */
+
+/*
+ * The XML file a tree is created from. The file is mapped into memory
+ * and parsed from there on a cache miss. The contents are only hashed
+ * if the key is actually needed: when a cache with a different time is
+ * checked or a new cache is written. Gzipped files are read and
+ * uncompressed instead.
+ */
+class TreeCacheSource
+{
+  private:
+    char const* mapped;
+    std::size_t mapped_size;
+    std::string contents;
+    TreeCacheKey key;
+    bool hashed;
+
+  private:
+    TreeCacheSource (TreeCacheSource const& other);
+    TreeCacheSource& operator= (TreeCacheSource const& other);
+
+  public:
+    TreeCacheSource (void);
+    ~TreeCacheSource (void);
+
+    /* Opens the XML file. Throws an exception on error. */
+    void open (std::string const& filename);
+
+    char const* get_data (void) const;
+    std::size_t get_size (void) const;
+
+    /* Returns size and modification time without hashing. */
+    TreeCacheKey const& get_stat_key (void) const;
+    /* Returns the full key, hashing the contents on first use. */
+    TreeCacheKey const& get_key (void);
+};
+
+/* ---------------------------------------------------------------- */
+
+/*
+ * Collects the binary snapshot of a tree and writes it to disc. The
+ * file is written to a temporary file first and renamed afterwards,
+ * so that a reader never sees a partially written cache.
+ */
+class TreeCacheWriter
+{
+  private:
+    std::string data;
+
+  public:
+    void write_int (int value);
+    void write_string (std::string const& str);
+
+    /* Writes the cache for the source file with the given key.
+     * Throws an exception on error. */
+    void save (std::string const& cache_fn, TreeCacheKey const& key);
+};
+
+/* ---------------------------------------------------------------- */
+
+/*
+ * Maps a binary snapshot of a tree into memory and reads it back.
+ * Reading beyond the end of the snapshot throws an exception.
+ */
+class TreeCacheReader
+{
+  private:
+    char const* data;
+    std::size_t size;
+    std::size_t pos;
+
+  protected:
+    void read_raw (void* buffer, std::size_t len);
+
+  public:
+    TreeCacheReader (void);
+    ~TreeCacheReader (void);
+
+    /* Opens the cache and checks that it belongs to the given source
+     * file. Returns false if there is no usable cache. */
+    bool open (std::string const& cache_fn, TreeCacheSource& source);
+
+    int read_int (void);
+    std::string read_string (void);
+    bool at_end (void) const;
+};
+
+/* ---------------------------------------------------------------- */
+
+inline char const*
+TreeCacheSource::get_data (void) const
+{
+  return this->mapped != 0 ? this->mapped : this->contents.data();
+}
+
+inline std::size_t
+TreeCacheSource::get_size (void) const
+{
+  return this->mapped != 0 ? this->mapped_size : this->contents.size();
+}
+
+inline TreeCacheKey const&
+TreeCacheSource::get_stat_key (void) const
+{
+  return this->key;
+}
+
+inline bool
+TreeCacheReader::at_end (void) const
+{
+  return this->pos == this->size;
+}
+
+#endif /* TREE_CACHE_HEADER */
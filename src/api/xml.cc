@@ -1,10 +1,29 @@
 #include <cstring>
+#include <cstdlib>
 #include <cerrno>
+#include <climits>
 
 #include "util/exception.h"
 #include "util/helpers.h"
 #include "xml.h"
 
+/* Converts an attribute value to int. Both parsers use this, so they
+ * reject the same malformed values. */
+static int
+convert_int_attribute (char const* value, char const* name)
+{
+  char* endptr;
+  errno = 0;
+  long ret = std::strtol(value, &endptr, 10);
+  if (endptr == value || *endptr != '\0' || errno == ERANGE
+      || ret < INT_MIN || ret > INT_MAX)
+    throw Exception(std::string("Invalid integer in property \"")
+        + name + "\": \"" + value + "\"");
+  return (int)ret;
+}
+
+/* ---------------------------------------------------------------- */
+
 void
 XmlDocument::parse (std::string const& data)
 {
@@ -51,6 +70,85 @@ XmlDocument::get_root_element (void)
 
 /* ================================================================ */
 
+XmlReader::XmlReader (char const* data, std::size_t size)
+{
+  /* HTTP documents carry a terminating zero the reader rejects. */
+  while (size > 0 && data[size - 1] == '\0')
+    size -= 1;
+
+  this->reader = xmlReaderForMemory(data, (int)size, 0, 0, XML_PARSE_NONET);
+  if (this->reader == 0)
+    throw Exception("Document not parsed successfully!");
+}
+
+/* ---------------------------------------------------------------- */
+
+bool
+XmlReader::next_element (void)
+{
+  while (true)
+  {
+    int ret = xmlTextReaderRead(this->reader);
+    if (ret < 0)
+      throw Exception("Document not parsed successfully!");
+    if (ret == 0)
+      return false;
+
+    if (xmlTextReaderNodeType(this->reader) == XML_READER_TYPE_ELEMENT)
+      return true;
+  }
+}
+
+/* ---------------------------------------------------------------- */
+
+char const*
+XmlReader::get_attribute (char const* name)
+{
+  if (xmlTextReaderMoveToAttribute(this->reader, (xmlChar const*)name) != 1)
+    return 0;
+
+  char const* value = (char const*)xmlTextReaderConstValue(this->reader);
+  xmlTextReaderMoveToElement(this->reader);
+  return value;
+}
+
+/* ---------------------------------------------------------------- */
+
+std::string
+XmlReader::get_attribute_string (char const* name)
+{
+  char const* value = this->get_attribute(name);
+  if (value == 0)
+    throw Exception(std::string("Could not find property \"") + name + "\"");
+  return value;
+}
+
+/* ---------------------------------------------------------------- */
+
+int
+XmlReader::get_attribute_int (char const* name)
+{
+  char const* value = this->get_attribute(name);
+  if (value == 0)
+    throw Exception(std::string("Could not find property \"") + name + "\"");
+  return convert_int_attribute(value, name);
+}
+
+/* ---------------------------------------------------------------- */
+
+std::string
+XmlReader::read_text (void)
+{
+  xmlChar* text = xmlTextReaderReadString(this->reader);
+  if (text == 0)
+    return std::string();
+  std::string ret((char const*)text);
+  xmlFree(text);
+  return ret;
+}
+
+/* ================================================================ */
+
 std::string
 XmlBase::get_node_text (xmlNodePtr node)
 {
@@ -81,7 +179,7 @@ int
 XmlBase::get_property_int (xmlNodePtr node, char const* name)
 {
   std::string prop_str = this->get_property(node, name);
-  return Helpers::get_int_from_string(prop_str);
+  return convert_int_attribute(prop_str.c_str(), name);
 }
 
 /* ---------------------------------------------------------------- */
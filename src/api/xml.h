@@ -16,6 +16,7 @@
 #include <string>
 #include <libxml/xmlmemory.h>
 #include <libxml/parser.h>
+#include <libxml/xmlreader.h>
 
 #include "util/ref_ptr.h"
 
@@ -45,6 +46,43 @@ class XmlDocument
 
 /* ---------------------------------------------------------------- */
 
+/*
+ * Streaming access to an XML document in memory. Elements are visited
+ * in document order without building a tree. Attribute values are
+ * returned as pointers into the buffers of the reader, which are only
+ * valid until the next call to the reader.
+ */
+class XmlReader
+{
+  private:
+    xmlTextReaderPtr reader;
+
+  private:
+    XmlReader (XmlReader const& other);
+    XmlReader& operator= (XmlReader const& other);
+
+  public:
+    XmlReader (char const* data, std::size_t size);
+    ~XmlReader (void);
+
+    /* Advances to the next start tag. Returns false at the end. */
+    bool next_element (void);
+    /* Returns the depth of the current element, the root has depth 0. */
+    int get_depth (void);
+    bool is_element (char const* name);
+
+    /* Returns the attribute value or 0 if there is no such attribute. */
+    char const* get_attribute (char const* name);
+    /* These throw an exception if there is no such attribute. */
+    std::string get_attribute_string (char const* name);
+    int get_attribute_int (char const* name);
+
+    /* Returns the text content of the current element. */
+    std::string read_text (void);
+};
+
+/* ---------------------------------------------------------------- */
+
 class XmlBase
 {
   protected:
@@ -76,13 +114,13 @@ XmlDocument::XmlDocument (void)
 inline XmlDocumentPtr
 XmlDocument::create (void)
 {
-  return XmlDocumentPtr(new XmlDocument);
+  return make_ref<XmlDocument>();
 }
 
 inline XmlDocumentPtr
 XmlDocument::create (std::string const& data)
 {
-  XmlDocumentPtr doc = XmlDocumentPtr(new XmlDocument);
+  XmlDocumentPtr doc = make_ref<XmlDocument>();
   doc->parse(data);
   return doc;
 }
@@ -90,7 +128,7 @@ XmlDocument::create (std::string const& data)
 inline XmlDocumentPtr
 XmlDocument::create (char const* data, std::size_t size)
 {
-  XmlDocumentPtr doc = XmlDocumentPtr(new XmlDocument);
+  XmlDocumentPtr doc = make_ref<XmlDocument>();
   doc->parse(data, size);
   return doc;
 }
@@ -98,7 +136,7 @@ XmlDocument::create (char const* data, std::size_t size)
 inline XmlDocumentPtr
 XmlDocument::create_from_file (std::string const& filename)
 {
-  XmlDocumentPtr doc = XmlDocumentPtr(new XmlDocument);
+  XmlDocumentPtr doc = make_ref<XmlDocument>();
   doc->parse_from_file(filename);
   return doc;
 }
@@ -109,4 +147,23 @@ XmlDocument::~XmlDocument (void)
   xmlFreeDoc(this->doc);
 }
 
+inline
+XmlReader::~XmlReader (void)
+{
+  xmlFreeTextReader(this->reader);
+}
+
+inline int
+XmlReader::get_depth (void)
+{
+  return xmlTextReaderDepth(this->reader);
+}
+
+inline bool
+XmlReader::is_element (char const* name)
+{
+  return !xmlStrcmp(xmlTextReaderConstLocalName(this->reader),
+      (xmlChar const*)name);
+}
+
 #endif /* XML_HEADER */
@@ -0,0 +1,365 @@
+#include <limits>
+#include <algorithm>
+
+#include "util/os.h"
+#include "threadpool.h"
+#include "attriboptimizer.h"
+
+/* Don't bother to submit a task for less candidates than this. */
+#define ATTRIB_OPT_MIN_CHUNK 64
+
+/*
+ * Pool task that either estimates or exactly evaluates a
+ * range of candidates. The ranges of all workers are disjoint.
+ */
+class AttribOptWorker : public ThreadPoolTask
+{
+  private:
+    AttribOptimizer* opt;
+    std::size_t begin;
+    std::size_t end;
+    bool exact;
+
+  protected:
+    void run (void);
+
+  public:
+    AttribOptWorker (AttribOptimizer* opt, std::size_t begin,
+        std::size_t end, bool exact);
+};
+
+/* ---------------------------------------------------------------- */
+
+AttribOptWorker::AttribOptWorker (AttribOptimizer* opt, std::size_t begin,
+    std::size_t end, bool exact)
+  : opt(opt), begin(begin), end(end), exact(exact)
+{
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+AttribOptWorker::run (void)
+{
+  if (this->exact)
+    this->opt->evaluate_range(this->begin, this->end);
+  else
+    this->opt->estimate_range(this->begin, this->end);
+}
+
+/* ================================================================ */
+
+AttribOptimizer::AttribOptimizer (void)
+  : cancelled(false), started(false)
+{
+}
+
+/* ---------------------------------------------------------------- */
+
+AttribOptimizer::~AttribOptimizer (void)
+{
+  if (this->started)
+  {
+    this->cancel();
+    this->pt_join();
+  }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+AttribOptimizer::set_attribs (ApiCharAttribs const& base,
+    ApiCharAttribs const& implant, ApiCharAttribs const& total)
+{
+  this->base = base;
+  this->implant = implant;
+  this->total = total;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+AttribOptimizer::add_entry (ApiSkill const* skill, int sp)
+{
+  AttribOptEntry entry;
+  entry.primary = skill->primary;
+  entry.secondary = skill->secondary;
+  entry.sp = sp;
+  this->entries.push_back(entry);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+AttribOptimizer::cancel (void)
+{
+  this->cancelled = true;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+AttribOptimizer::optimize_async (void)
+{
+  this->started = true;
+  this->pt_create();
+}
+
+/* ---------------------------------------------------------------- */
+
+void*
+AttribOptimizer::run (void)
+{
+  this->optimize();
+  if (!this->cancelled)
+    this->sig_done.emit();
+
+  return 0;
+}
+
+/* ---------------------------------------------------------------- */
+
+AttribOptResult const&
+AttribOptimizer::optimize (void)
+{
+  this->reduce_plan();
+
+  this->result.base = this->base;
+  this->result.total = this->total;
+  this->result.orig_time = this->calc_exact_time(this->total);
+  this->result.best_time = this->result.orig_time;
+
+  /* Estimate all candidates and keep those that may be the best. */
+  this->create_candidates();
+  std::size_t amount = this->candidates.size() / 5;
+  this->estimates.resize(amount);
+  this->run_workers(amount, false);
+  if (this->cancelled)
+    return this->result;
+
+  this->select_survivors();
+  this->times.resize(this->survivors.size());
+  this->run_workers(this->survivors.size(), true);
+  if (this->cancelled)
+    return this->result;
+
+  /* Survivors are in search order. Only accepting strictly better remaps
+   * makes the first of several equally good remaps win, as it always did. */
+  for (std::size_t i = 0; i < this->survivors.size(); ++i)
+  {
+    if (this->times[i] < this->result.best_time)
+    {
+      this->result.best_time = this->times[i];
+      this->result.base = this->get_candidate_base(this->survivors[i]);
+      this->result.total = this->result.base + this->implant;
+    }
+  }
+
+  return this->result;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+AttribOptimizer::reduce_plan (void)
+{
+  for (int i = 0; i < ATTRIB_OPT_ATTRIBS; ++i)
+    for (int j = 0; j < ATTRIB_OPT_ATTRIBS; ++j)
+      this->pair_sp[i][j] = 0.0;
+
+  this->trunc_pos = 0;
+  this->trunc_neg = 0;
+  this->result.plan_sp = 0;
+
+  for (std::size_t i = 0; i < this->entries.size(); ++i)
+  {
+    AttribOptEntry const& entry = this->entries[i];
+    this->pair_sp[entry.primary][entry.secondary] += (double)entry.sp;
+    this->result.plan_sp += (unsigned int)entry.sp;
+
+    /* Positive times are rounded down, negative ones up. */
+    if (entry.sp > 0)
+      this->trunc_pos += 1;
+    else if (entry.sp < 0)
+      this->trunc_neg += 1;
+  }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+AttribOptimizer::create_candidates (void)
+{
+  /* Calculate the maximum number of points that can be assigned to each
+   * attribute. */
+  int max_points_per_att = MAXIMUM_VALUE_PER_ATTRIB
+      - MINIMUM_VALUE_PER_ATTRIB;
+
+  /* Calculate the total number of base attribute points to distribute if it
+   * changes in the future. */
+  int total_base_atts = (int)this->base.cha + (int)this->base.intl
+      + (int)this->base.mem + (int)this->base.per
+      + (int)this->base.wil - (MINIMUM_VALUE_PER_ATTRIB * 5);
+
+  /* Go through all combinations in the same order EVEMon does. */
+  this->candidates.clear();
+  for (int intl = 0; intl <= max_points_per_att; intl++)
+  {
+    int max_mem = total_base_atts - intl;
+    for (int mem = 0; mem <= max_points_per_att && mem <= max_mem; mem++)
+    {
+      int max_cha = max_mem - mem;
+      for (int cha = 0; cha <= max_points_per_att && cha <= max_cha; cha++)
+      {
+        int max_per = max_cha - cha;
+        for (int per = 0; per <= max_points_per_att && per <= max_per; per++)
+        {
+          int wil = max_per - per;
+          if (wil <= max_points_per_att)
+          {
+            this->candidates.push_back(intl);
+            this->candidates.push_back(mem);
+            this->candidates.push_back(cha);
+            this->candidates.push_back(per);
+            this->candidates.push_back(wil);
+          }
+        }
+      }
+    }
+  }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+AttribOptimizer::run_workers (std::size_t amount, bool exact)
+{
+  std::size_t chunk = amount / OS::cpu_count() + 1;
+  if (chunk < ATTRIB_OPT_MIN_CHUNK)
+    chunk = ATTRIB_OPT_MIN_CHUNK;
+
+  /* The first chunk is processed by the calling thread. */
+  std::vector<ref_ptr<AttribOptWorker> > workers;
+  for (std::size_t begin = chunk; begin < amount; begin += chunk)
+  {
+    std::size_t end = std::min(begin + chunk, amount);
+    ref_ptr<AttribOptWorker> worker = make_ref<AttribOptWorker>
+        (this, begin, end, exact);
+    ThreadPool::submit(worker);
+    workers.push_back(worker);
+  }
+
+  if (exact)
+    this->evaluate_range(0, std::min(chunk, amount));
+  else
+    this->estimate_range(0, std::min(chunk, amount));
+
+  for (std::size_t i = 0; i < workers.size(); ++i)
+    workers[i]->wait();
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+AttribOptimizer::estimate_range (std::size_t begin, std::size_t end)
+{
+  for (std::size_t i = begin; i < end && !this->cancelled; ++i)
+  {
+    ApiCharAttribs attribs = this->get_candidate_base(i) + this->implant;
+
+    double estimate = 0.0;
+    for (int pri = 0; pri < ATTRIB_OPT_ATTRIBS; ++pri)
+      for (int sec = 0; sec < ATTRIB_OPT_ATTRIBS; ++sec)
+      {
+        if (this->pair_sp[pri][sec] == 0.0)
+          continue;
+
+        unsigned int spph = ApiCharSheet::calc_spph
+            ((ApiAttrib)pri, (ApiAttrib)sec, attribs);
+        if (spph == 0)
+          estimate = std::numeric_limits<double>::infinity();
+        else
+          estimate += this->pair_sp[pri][sec] / (spph / 3600.0);
+      }
+
+    this->estimates[i] = estimate;
+  }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+AttribOptimizer::select_survivors (void)
+{
+  /* The exact time of a candidate is within the estimate minus the
+   * entries rounded down and the estimate plus the entries rounded up.
+   * One more second of slack covers floating point differences. */
+  double best_upper = std::numeric_limits<double>::infinity();
+  for (std::size_t i = 0; i < this->estimates.size(); ++i)
+    best_upper = std::min(best_upper,
+        this->estimates[i] + (double)this->trunc_neg);
+
+  this->survivors.clear();
+  for (std::size_t i = 0; i < this->estimates.size(); ++i)
+    if (this->estimates[i] - (double)this->trunc_pos <= best_upper + 1.0)
+      this->survivors.push_back(i);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+AttribOptimizer::evaluate_range (std::size_t begin, std::size_t end)
+{
+  for (std::size_t i = begin; i < end && !this->cancelled; ++i)
+  {
+    ApiCharAttribs attribs = this->get_candidate_base(this->survivors[i])
+        + this->implant;
+    this->times[i] = this->calc_exact_time(attribs);
+  }
+}
+
+/* ---------------------------------------------------------------- */
+
+ApiCharAttribs
+AttribOptimizer::get_candidate_base (std::size_t index) const
+{
+  int const* cand = &this->candidates[index * 5];
+
+  ApiCharAttribs attribs;
+  attribs.intl = cand[0] + MINIMUM_VALUE_PER_ATTRIB;
+  attribs.mem = cand[1] + MINIMUM_VALUE_PER_ATTRIB;
+  attribs.cha = cand[2] + MINIMUM_VALUE_PER_ATTRIB;
+  attribs.per = cand[3] + MINIMUM_VALUE_PER_ATTRIB;
+  attribs.wil = cand[4] + MINIMUM_VALUE_PER_ATTRIB;
+  return attribs;
+}
+
+/* ---------------------------------------------------------------- */
+
+time_t
+AttribOptimizer::calc_exact_time (ApiCharAttribs const& attribs) const
+{
+  /* SP per second for every attribute pair. */
+  double spps[ATTRIB_OPT_ATTRIBS][ATTRIB_OPT_ATTRIBS];
+  for (int pri = 0; pri < ATTRIB_OPT_ATTRIBS; ++pri)
+    for (int sec = 0; sec < ATTRIB_OPT_ATTRIBS; ++sec)
+      spps[pri][sec] = ApiCharSheet::calc_spph
+          ((ApiAttrib)pri, (ApiAttrib)sec, attribs) / 3600.0;
+
+  /* Truncate per entry exactly like GtkSkillList::calc_details does. */
+  time_t duration = 0;
+  for (std::size_t i = 0; i < this->entries.size(); ++i)
+  {
+    AttribOptEntry const& entry = this->entries[i];
+    if (entry.sp == 0)
+      continue;
+
+    double entry_spps = spps[entry.primary][entry.secondary];
+    if (entry_spps == 0.0)
+      return std::numeric_limits<time_t>::max();
+
+    duration += (time_t)((double)entry.sp / entry_spps);
+  }
+
+  return duration;
+}
@@ -0,0 +1,149 @@
+/*
+ * This file is part of GtkEveMon.
+ *
+ * GtkEveMon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GtkEveMon. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ATTRIB_OPTIMIZER_HEADER
+#define ATTRIB_OPTIMIZER_HEADER
+
+#include <vector>
+#include <ctime>
+#include <atomic>
+#include <glibmm/dispatcher.h>
+
+#include "util/ref_ptr.h"
+#include "util/thread.h"
+#include "api/apiskilltree.h"
+#include "api/apicharsheet.h"
+
+/* The minimum number of points that have to be assigned to each attribute. */
+#define MINIMUM_VALUE_PER_ATTRIB 17
+/* The maximum number of points that can be assigned to each attribute. */
+#define MAXIMUM_VALUE_PER_ATTRIB 27
+
+/* The amount of attributes, including the unknown one. */
+#define ATTRIB_OPT_ATTRIBS (API_ATTRIB_UNKNOWN + 1)
+
+/* A single plan entry reduced to what affects its training time. */
+struct AttribOptEntry
+{
+  ApiAttrib primary;
+  ApiAttrib secondary;
+  int sp;
+};
+
+/* ---------------------------------------------------------------- */
+
+struct AttribOptResult
+{
+  ApiCharAttribs base;
+  ApiCharAttribs total;
+  time_t orig_time;
+  time_t best_time;
+  unsigned int plan_sp;
+};
+
+/* ---------------------------------------------------------------- */
+
+class AttribOptimizer;
+typedef ref_ptr<AttribOptimizer> AttribOptimizerPtr;
+
+/*
+ * Finds the base attribute remap that trains a plan fastest. Every
+ * possible remap is tried, just like EVEMon does, but the plan is first
+ * reduced to the SP totals per (primary, secondary) attribute pair.
+ * That gives a cheap estimate for each remap which is off by less than
+ * a second per plan entry (training times are truncated per entry).
+ * Only remaps whose estimate can still beat the best one are evaluated
+ * exactly, which yields the very same remap as the full search.
+ *
+ * The search is split into thread pool tasks. It can be run blocking
+ * with optimize() or in a separate thread with optimize_async(), which
+ * fires the done signal in the main loop once the result is available.
+ * Destroying the optimizer cancels and waits for a running search.
+ */
+class AttribOptimizer : public Thread
+{
+  private:
+    std::vector<AttribOptEntry> entries;
+    ApiCharAttribs base;
+    ApiCharAttribs implant;
+    ApiCharAttribs total;
+
+    /* Pair SP totals and amount of entries that are truncated. */
+    double pair_sp[ATTRIB_OPT_ATTRIBS][ATTRIB_OPT_ATTRIBS];
+    unsigned int trunc_pos;
+    unsigned int trunc_neg;
+
+    /* Candidate remaps (intl, mem, cha, per, wil) and their times. */
+    std::vector<int> candidates;
+    std::vector<double> estimates;
+    std::vector<time_t> times;
+    std::vector<std::size_t> survivors;
+
+    std::atomic<bool> cancelled;
+    bool started;
+    AttribOptResult result;
+    Glib::Dispatcher sig_done;
+
+  protected:
+    friend class AttribOptWorker;
+
+    void* run (void);
+    void create_candidates (void);
+    void reduce_plan (void);
+    void run_workers (std::size_t amount, bool exact);
+    void estimate_range (std::size_t begin, std::size_t end);
+    void evaluate_range (std::size_t begin, std::size_t end);
+    void select_survivors (void);
+
+    ApiCharAttribs get_candidate_base (std::size_t index) const;
+    time_t calc_exact_time (ApiCharAttribs const& attribs) const;
+
+  public:
+    AttribOptimizer (void);
+    ~AttribOptimizer (void);
+    static AttribOptimizerPtr create (void);
+
+    /* Sets the character attributes the remaps are calculated for. */
+    void set_attribs (ApiCharAttribs const& base,
+        ApiCharAttribs const& implant, ApiCharAttribs const& total);
+    /* Adds a plan entry with the given amount of SP left to train. */
+    void add_entry (ApiSkill const* skill, int sp);
+
+    AttribOptResult const& optimize (void);
+    void optimize_async (void);
+    void cancel (void);
+
+    AttribOptResult const& get_result (void) const;
+    Glib::Dispatcher& signal_done (void);
+};
+
+/* ---------------------------------------------------------------- */
+
+inline AttribOptimizerPtr
+AttribOptimizer::create (void)
+{
+  return make_ref<AttribOptimizer>();
+}
+
+inline AttribOptResult const&
+AttribOptimizer::get_result (void) const
+{
+  return this->result;
+}
+
+inline Glib::Dispatcher&
+AttribOptimizer::signal_done (void)
+{
+  return this->sig_done;
+}
+
+#endif /* ATTRIB_OPTIMIZER_HEADER */
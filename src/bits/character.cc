@@ -58,6 +58,13 @@ Character::on_cs_available (EveApiData data)
     return;
   }
 
+  /* Only the cache times changed, the GUI needs no rebuild. */
+  if (this->cs->is_unchanged())
+  {
+    this->sig_api_info_changed.emit();
+    return;
+  }
+
   if (yet_unnamed && !this->cs->name.empty())
     this->sig_name_available.emit(this->auth.char_id);
 
@@ -89,6 +96,12 @@ Character::on_sq_available (EveApiData data)
     return;
   }
 
+  if (this->sq->is_unchanged())
+  {
+    this->sig_api_info_changed.emit();
+    return;
+  }
+
   this->process_api_data();
   this->sig_skill_queue_updated.emit();
   this->sig_api_info_changed.emit();
@@ -129,7 +129,7 @@ class Character
 inline CharacterPtr
 Character::create (EveApiAuth const& auth)
 {
-  return CharacterPtr(new Character(auth));
+  return make_ref<Character>(auth);
 }
 
 inline std::string const&
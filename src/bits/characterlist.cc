@@ -14,7 +14,7 @@ CharacterList::request (void)
 {
   if (CharacterList::instance.get() == 0)
   {
-    CharacterList::instance = CharacterListPtr(new CharacterList);
+    CharacterList::instance = make_ref<CharacterList>();
     CharacterList::instance->init_from_config();
   }
 
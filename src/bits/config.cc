@@ -23,6 +23,8 @@ char const* default_config =
     "  use_proxy = false\n"
     "  proxy_address = \n"
     "  proxy_port = 80\n"
+    "  api_host = api.eveonline.com\n"
+    "  api_max_requests = 4\n"
     "  api_ssl = true\n"
     "[notifications]\n"
     "  show_popup_dialog = true\n"
@@ -49,6 +51,7 @@ char const* default_config =
     "  eve_command_5 = \n"
     "  minimize_on_close = false\n"
     "  startup_servercheck = true\n"
+    "  streaming_parser = true\n"
     "  tray_usage = never\n"
     "  trunc_corpname = false\n"
     "  verbose_wintitle = true\n"
@@ -56,8 +59,12 @@ char const* default_config =
     "  columns_format = +0 +1 -2 -3 -4 +5 -6 +7\n"
     "[updater]\n"
     "  autocheck = true\n"
+    "  certtree_etag = \n"
+    "  certtree_modified = \n"
     "  check_interval = 604800\n"
-    "  last_update = 0\n";
+    "  last_update = 0\n"
+    "  skilltree_etag = \n"
+    "  skilltree_modified = \n";
 
 /* The initial configuration is loaded once if the configuration
  * file is created for the first time. Thus it initializes the
@@ -0,0 +1,128 @@
+#include <vector>
+#include <glibmm/main.h>
+
+#include "util/os.h"
+#include "refreshtimer.h"
+
+RefreshTimer::EntryMap RefreshTimer::entries;
+RefreshTimer::DeadlineMap RefreshTimer::deadlines;
+unsigned int RefreshTimer::next_id = 1;
+uint64_t RefreshTimer::armed_deadline = 0;
+sigc::connection RefreshTimer::armed_timeout;
+
+/* ---------------------------------------------------------------- */
+
+unsigned int
+RefreshTimer::schedule (unsigned int id, uint64_t delay_ms,
+    Callback const& callback)
+{
+  uint64_t deadline = OS::monotonic_ms() + delay_ms;
+  deadline = (deadline + REFRESH_TIMER_SLOT_MS - 1)
+      / REFRESH_TIMER_SLOT_MS * REFRESH_TIMER_SLOT_MS;
+
+  EntryMap::iterator iter = RefreshTimer::entries.find(id);
+  if (id == 0 || iter == RefreshTimer::entries.end())
+  {
+    id = RefreshTimer::next_id++;
+    if (RefreshTimer::next_id == 0)
+      RefreshTimer::next_id = 1;
+    iter = RefreshTimer::entries.insert(std::make_pair(id, Entry())).first;
+  }
+  else
+    RefreshTimer::remove_deadline(id, iter->second.deadline);
+
+  iter->second.deadline = deadline;
+  iter->second.callback = callback;
+  RefreshTimer::deadlines.insert(std::make_pair(deadline, id));
+
+  RefreshTimer::arm();
+  return id;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+RefreshTimer::cancel (unsigned int id)
+{
+  EntryMap::iterator iter = RefreshTimer::entries.find(id);
+  if (iter == RefreshTimer::entries.end())
+    return;
+
+  RefreshTimer::remove_deadline(id, iter->second.deadline);
+  RefreshTimer::entries.erase(iter);
+  RefreshTimer::arm();
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+RefreshTimer::remove_deadline (unsigned int id, uint64_t deadline)
+{
+  std::pair<DeadlineMap::iterator, DeadlineMap::iterator> range
+      = RefreshTimer::deadlines.equal_range(deadline);
+  for (DeadlineMap::iterator iter = range.first;
+      iter != range.second; iter++)
+  {
+    if (iter->second == id)
+    {
+      RefreshTimer::deadlines.erase(iter);
+      break;
+    }
+  }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+RefreshTimer::arm (void)
+{
+  if (RefreshTimer::deadlines.empty())
+  {
+    RefreshTimer::armed_timeout.disconnect();
+    RefreshTimer::armed_deadline = 0;
+    return;
+  }
+
+  /* Keep the main loop timeout if it's set for the earliest deadline. */
+  uint64_t deadline = RefreshTimer::deadlines.begin()->first;
+  if (RefreshTimer::armed_timeout.connected()
+      && RefreshTimer::armed_deadline == deadline)
+    return;
+
+  uint64_t now = OS::monotonic_ms();
+  uint64_t delay = (deadline > now ? deadline - now : 0);
+
+  RefreshTimer::armed_timeout.disconnect();
+  RefreshTimer::armed_deadline = deadline;
+  RefreshTimer::armed_timeout = Glib::signal_timeout().connect
+      (sigc::ptr_fun(&RefreshTimer::on_timeout), (unsigned int)delay);
+}
+
+/* ---------------------------------------------------------------- */
+
+bool
+RefreshTimer::on_timeout (void)
+{
+  RefreshTimer::armed_timeout.disconnect();
+  RefreshTimer::armed_deadline = 0;
+
+  /* Collect expired timers first, callbacks may schedule new ones. */
+  uint64_t now = OS::monotonic_ms();
+  std::vector<Callback> expired;
+  while (!RefreshTimer::deadlines.empty()
+      && RefreshTimer::deadlines.begin()->first <= now)
+  {
+    unsigned int id = RefreshTimer::deadlines.begin()->second;
+    RefreshTimer::deadlines.erase(RefreshTimer::deadlines.begin());
+
+    EntryMap::iterator iter = RefreshTimer::entries.find(id);
+    expired.push_back(iter->second.callback);
+    RefreshTimer::entries.erase(iter);
+  }
+
+  for (std::size_t i = 0; i < expired.size(); ++i)
+    expired[i]();
+
+  RefreshTimer::arm();
+  return false;
+}
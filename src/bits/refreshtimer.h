@@ -0,0 +1,68 @@
+/*
+ * This file is part of GtkEveMon.
+ *
+ * GtkEveMon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GtkEveMon. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REFRESH_TIMER_HEADER
+#define REFRESH_TIMER_HEADER
+
+#include <map>
+#include <stdint.h>
+#include <sigc++/sigc++.h>
+
+/* Deadlines are rounded up to slots of this many milli seconds,
+ * so timers that expire close together fire with a single wakeup. */
+#define REFRESH_TIMER_SLOT_MS 1000
+
+/*
+ * Global timer for events that happen rarely and at known times, such
+ * as the expiry of API sheets. There is only one main loop timeout,
+ * which is armed for the earliest deadline, instead of every user
+ * polling with its own timeout. Must only be used from the main thread.
+ * Delays are measured on the monotonic clock, which stops while the
+ * system is suspended. Users that wait for a wall clock time should use
+ * moderate delays and check the time again when they wake up.
+ */
+class RefreshTimer
+{
+  public:
+    typedef sigc::slot<void> Callback;
+
+  private:
+    struct Entry
+    {
+      uint64_t deadline;
+      Callback callback;
+    };
+
+    typedef std::map<unsigned int, Entry> EntryMap;
+    typedef std::multimap<uint64_t, unsigned int> DeadlineMap;
+
+    static EntryMap entries;
+    static DeadlineMap deadlines;
+    static unsigned int next_id;
+    static uint64_t armed_deadline;
+    static sigc::connection armed_timeout;
+
+    static void remove_deadline (unsigned int id, uint64_t deadline);
+    static void arm (void);
+    static bool on_timeout (void);
+
+  public:
+    /* Calls the callback once after the delay in milli seconds. If the
+     * ID of a pending timer is given, that timer is moved. Returns the
+     * ID of the timer, which is never 0. */
+    static unsigned int schedule (unsigned int id, uint64_t delay_ms,
+        Callback const& callback);
+    /* Cancels the timer. IDs of expired timers and 0 are ignored. */
+    static void cancel (unsigned int id);
+};
+
+#endif /* REFRESH_TIMER_HEADER */
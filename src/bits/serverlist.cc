@@ -81,7 +81,7 @@ void
 ServerList::add_server (std::string const& name,
     std::string const& host, uint16_t port)
 {
-  ServerPtr server = ServerPtr(new Server(name, host, port));
+  ServerPtr server = make_ref<Server>(name, host, port);
   ServerList::list.push_back(server);
 }
 
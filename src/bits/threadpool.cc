@@ -0,0 +1,333 @@
+#include <deque>
+#include <iostream>
+
+#include "util/os.h"
+#include "threadpool.h"
+
+/* A worker thread and its task queue. */
+class ThreadPoolWorker : public Thread
+{
+  protected:
+    void* run (void);
+
+  public:
+    std::size_t index;
+    std::deque<ThreadPoolTaskPtr> queue;
+    Semaphore lock;
+
+    ThreadPoolWorker (std::size_t index);
+};
+
+/* The worker of the calling thread, if it is one, and the amount of
+ * tasks it runs at the moment, including tasks run while waiting. */
+static thread_local ThreadPoolWorker* current_worker = 0;
+static thread_local unsigned int current_depth = 0;
+
+/* ---------------------------------------------------------------- */
+
+ThreadPoolWorker::ThreadPoolWorker (std::size_t index)
+  : index(index)
+{
+}
+
+/* ---------------------------------------------------------------- */
+
+void*
+ThreadPoolWorker::run (void)
+{
+  current_worker = this;
+
+  /* The semaphore is posted once per queued task. The task may have
+   * been taken by a waiting worker already, then just wait again. */
+  while (true)
+  {
+    ThreadPool::pending.wait();
+    if (ThreadPool::stopping)
+      break;
+
+    ThreadPoolTaskPtr task = ThreadPool::take_task(this->index);
+    if (task.get() != 0)
+      ThreadPool::run_task(task);
+  }
+
+  return 0;
+}
+
+/* ================================================================ */
+
+ThreadPoolTask::ThreadPoolTask (void)
+  : finished(false), finished_sem(0), submit_time(0)
+{
+}
+
+/* ---------------------------------------------------------------- */
+
+ThreadPoolTask::~ThreadPoolTask (void)
+{
+}
+
+/* ================================================================ */
+
+std::vector<ThreadPoolWorker*> ThreadPool::workers;
+Semaphore ThreadPool::pending(0);
+std::atomic<bool> ThreadPool::stopping(false);
+std::atomic<unsigned int> ThreadPool::next_queue(0);
+std::vector<ThreadPoolTaskPtr> ThreadPool::done_tasks;
+Semaphore ThreadPool::done_lock;
+Glib::Dispatcher* ThreadPool::sig_dispatch = 0;
+uint64_t ThreadPool::start_time = 0;
+std::atomic<uint64_t> ThreadPool::submitted(0);
+std::atomic<uint64_t> ThreadPool::started(0);
+std::atomic<uint64_t> ThreadPool::completed(0);
+std::atomic<uint64_t> ThreadPool::total_latency(0);
+std::atomic<uint64_t> ThreadPool::max_latency(0);
+std::atomic<uint64_t> ThreadPool::busy_time(0);
+
+/* ---------------------------------------------------------------- */
+
+void
+ThreadPool::init (void)
+{
+  ThreadPool::sig_dispatch = new Glib::Dispatcher;
+  ThreadPool::sig_dispatch->connect(sigc::ptr_fun(&ThreadPool::on_dispatch));
+  ThreadPool::start_time = OS::monotonic_ms();
+  ThreadPool::stopping = false;
+
+  unsigned int amount = OS::cpu_count();
+  if (amount < 2)
+    amount = 2;
+  for (unsigned int i = 0; i < amount; ++i)
+    ThreadPool::workers.push_back(new ThreadPoolWorker(i));
+  for (unsigned int i = 0; i < amount; ++i)
+    ThreadPool::workers[i]->pt_create();
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+ThreadPool::unload (void)
+{
+  if (ThreadPool::workers.empty())
+    return;
+
+  ThreadPoolStats stats = ThreadPool::get_stats();
+  std::cout << "Thread pool: " << stats.tasks << " tasks, "
+      << stats.avg_latency << " ms average queue latency, "
+      << (stats.utilization * 100.0) << "% utilization" << std::endl;
+
+  /* Running tasks are finished by the workers. Tasks submitted from
+   * now on run right away, see submit(). */
+  ThreadPool::stopping = true;
+  for (std::size_t i = 0; i < ThreadPool::workers.size(); ++i)
+    ThreadPool::pending.post();
+  for (std::size_t i = 0; i < ThreadPool::workers.size(); ++i)
+    ThreadPool::workers[i]->pt_join();
+
+  /* Queued tasks are run here, somebody may wait for them. */
+  for (std::size_t i = 0; i < ThreadPool::workers.size(); ++i)
+  {
+    ThreadPoolWorker* worker = ThreadPool::workers[i];
+    while (true)
+    {
+      worker->lock.wait();
+      if (worker->queue.empty())
+      {
+        worker->lock.post();
+        break;
+      }
+      ThreadPoolTaskPtr task = worker->queue.front();
+      worker->queue.pop_front();
+      worker->lock.post();
+      ThreadPool::run_task(task);
+    }
+    delete worker;
+  }
+  ThreadPool::workers.clear();
+
+  ThreadPool::done_lock.wait();
+  delete ThreadPool::sig_dispatch;
+  ThreadPool::sig_dispatch = 0;
+  ThreadPool::done_tasks.clear();
+  ThreadPool::done_lock.post();
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+ThreadPool::submit (ThreadPoolTaskPtr task)
+{
+  /* Consume the wakeup of the previous run. */
+  if (task->finished)
+  {
+    task->finished = false;
+    task->finished_sem.wait();
+  }
+
+  task->submit_time = OS::monotonic_ms();
+  ThreadPool::submitted += 1;
+
+  if (ThreadPool::workers.empty() || ThreadPool::stopping)
+  {
+    ThreadPool::run_task(task);
+    return;
+  }
+
+  std::size_t index = (current_worker != 0 ? current_worker->index
+      : ThreadPool::next_queue++ % ThreadPool::workers.size());
+  /* Checked again under the lock, unload() may have emptied the
+   * queues already. */
+  ThreadPoolWorker* worker = ThreadPool::workers[index];
+  worker->lock.wait();
+  if (ThreadPool::stopping)
+  {
+    worker->lock.post();
+    ThreadPool::run_task(task);
+    return;
+  }
+  worker->queue.push_back(task);
+  worker->lock.post();
+
+  ThreadPool::pending.post();
+}
+
+/* ---------------------------------------------------------------- */
+
+ThreadPoolStats
+ThreadPool::get_stats (void)
+{
+  uint64_t started = ThreadPool::started;
+  uint64_t completed = ThreadPool::completed;
+
+  ThreadPoolStats stats;
+  stats.workers = (unsigned int)ThreadPool::workers.size();
+  stats.queued = (unsigned int)(ThreadPool::submitted - started);
+  stats.running = (unsigned int)(started - completed);
+  stats.tasks = completed;
+  stats.avg_latency = (started == 0 ? 0.0
+      : (double)ThreadPool::total_latency / (double)started);
+  stats.max_latency = ThreadPool::max_latency;
+
+  uint64_t elapsed = OS::monotonic_ms() - ThreadPool::start_time;
+  stats.utilization = (elapsed == 0 || stats.workers == 0 ? 0.0
+      : (double)ThreadPool::busy_time / ((double)elapsed * stats.workers));
+
+  return stats;
+}
+
+/* ---------------------------------------------------------------- */
+
+ThreadPoolTaskPtr
+ThreadPool::take_task (std::size_t index)
+{
+  /* The own queue is used from the back, others are robbed from the
+   * front where the oldest tasks are. */
+  std::size_t amount = ThreadPool::workers.size();
+  for (std::size_t i = 0; i < amount; ++i)
+  {
+    ThreadPoolWorker* worker = ThreadPool::workers[(index + i) % amount];
+    worker->lock.wait();
+    if (worker->queue.empty())
+    {
+      worker->lock.post();
+      continue;
+    }
+
+    ThreadPoolTaskPtr task;
+    if (i == 0)
+    {
+      task = worker->queue.back();
+      worker->queue.pop_back();
+    }
+    else
+    {
+      task = worker->queue.front();
+      worker->queue.pop_front();
+    }
+    worker->lock.post();
+    return task;
+  }
+
+  return ThreadPoolTaskPtr();
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+ThreadPool::run_task (ThreadPoolTaskPtr task)
+{
+  uint64_t start = OS::monotonic_ms();
+  uint64_t latency = start - task->submit_time;
+  ThreadPool::total_latency += latency;
+  uint64_t max = ThreadPool::max_latency;
+  while (latency > max
+      && !ThreadPool::max_latency.compare_exchange_weak(max, latency))
+    ;
+  ThreadPool::started += 1;
+
+  current_depth += 1;
+  try
+  {
+    task->run();
+  }
+  catch (...)
+  {
+    std::cout << "Bug: Uncaught exception in thread pool task" << std::endl;
+  }
+  current_depth -= 1;
+
+  /* Tasks run while waiting are part of the outer task's time. */
+  if (current_depth == 0)
+    ThreadPool::busy_time += OS::monotonic_ms() - start;
+  ThreadPool::completed += 1;
+
+  task->finished = true;
+  task->finished_sem.post();
+
+  ThreadPool::done_lock.wait();
+  if (ThreadPool::sig_dispatch != 0)
+  {
+    ThreadPool::done_tasks.push_back(task);
+    ThreadPool::sig_dispatch->emit();
+  }
+  ThreadPool::done_lock.post();
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+ThreadPool::wait_for (ThreadPoolTask* task)
+{
+  /* A waiting worker runs other tasks, the awaited one may be among
+   * them. If nothing is queued, the task is already running. */
+  if (current_worker != 0)
+  {
+    while (!task->finished)
+    {
+      ThreadPoolTaskPtr other = ThreadPool::take_task(current_worker->index);
+      if (other.get() == 0)
+        break;
+      ThreadPool::run_task(other);
+    }
+  }
+
+  /* Pass the wakeup on to other waiters. */
+  if (!task->finished)
+  {
+    task->finished_sem.wait();
+    task->finished_sem.post();
+  }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+ThreadPool::on_dispatch (void)
+{
+  std::vector<ThreadPoolTaskPtr> tasks;
+  ThreadPool::done_lock.wait();
+  tasks.swap(ThreadPool::done_tasks);
+  ThreadPool::done_lock.post();
+
+  for (std::size_t i = 0; i < tasks.size(); ++i)
+    tasks[i]->sig_done.emit();
+}
@@ -0,0 +1,143 @@
+/*
+ * This file is part of GtkEveMon.
+ *
+ * GtkEveMon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GtkEveMon. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef THREAD_POOL_HEADER
+#define THREAD_POOL_HEADER
+
+#include <atomic>
+#include <vector>
+#include <stdint.h>
+#include <sigc++/sigc++.h>
+#include <glibmm/dispatcher.h>
+
+#include "util/ref_ptr.h"
+#include "util/thread.h"
+
+class ThreadPoolTask;
+class ThreadPoolWorker;
+typedef ref_ptr<ThreadPoolTask> ThreadPoolTaskPtr;
+
+/*
+ * A task for the thread pool. run() is called in a worker thread. The
+ * done signal is emitted in the main thread after run() returned, and
+ * the pool keeps the task alive until then. wait() blocks until run()
+ * returned, so the task can be used as a future for its results.
+ * A finished task may be submitted again.
+ */
+class ThreadPoolTask
+{
+  friend class ThreadPool;
+
+  private:
+    std::atomic<bool> finished;
+    Semaphore finished_sem;
+    uint64_t submit_time;
+    sigc::signal<void> sig_done;
+
+  protected:
+    virtual void run (void) = 0;
+
+  public:
+    ThreadPoolTask (void);
+    virtual ~ThreadPoolTask (void);
+
+    bool is_finished (void) const;
+    void wait (void);
+    sigc::signal<void>& signal_done (void);
+};
+
+/* ---------------------------------------------------------------- */
+
+/* Counters to see how busy the pool is. Times are in milli seconds. */
+struct ThreadPoolStats
+{
+  unsigned int workers;
+  unsigned int queued;
+  unsigned int running;
+  uint64_t tasks;
+  double avg_latency;
+  uint64_t max_latency;
+  double utilization;
+};
+
+/* ---------------------------------------------------------------- */
+
+/*
+ * Fixed amount of worker threads, one per CPU, for short tasks such as
+ * decoding and computations. Tasks should not block for long, since
+ * unload() waits for running tasks. Long running loops and blocking
+ * network requests keep their own Thread. Every worker has its
+ * own queue. Tasks submitted from a worker are queued there and run
+ * last in, first out, other tasks are distributed round robin. Idle
+ * workers steal the oldest tasks from other queues. Workers that wait
+ * for a task run other tasks meanwhile, so nested tasks can't deadlock.
+ * Tasks submitted before init() or after unload() run immediately.
+ */
+class ThreadPool
+{
+  friend class ThreadPoolTask;
+  friend class ThreadPoolWorker;
+
+  private:
+    static std::vector<ThreadPoolWorker*> workers;
+    static Semaphore pending;
+    static std::atomic<bool> stopping;
+    static std::atomic<unsigned int> next_queue;
+
+    /* Finished tasks to be delivered in the main thread. */
+    static std::vector<ThreadPoolTaskPtr> done_tasks;
+    static Semaphore done_lock;
+    static Glib::Dispatcher* sig_dispatch;
+
+    /* Statistics. */
+    static uint64_t start_time;
+    static std::atomic<uint64_t> submitted;
+    static std::atomic<uint64_t> started;
+    static std::atomic<uint64_t> completed;
+    static std::atomic<uint64_t> total_latency;
+    static std::atomic<uint64_t> max_latency;
+    static std::atomic<uint64_t> busy_time;
+
+    static ThreadPoolTaskPtr take_task (std::size_t index);
+    static void run_task (ThreadPoolTaskPtr task);
+    static void wait_for (ThreadPoolTask* task);
+    static void on_dispatch (void);
+
+  public:
+    static void init (void);
+    static void unload (void);
+
+    static void submit (ThreadPoolTaskPtr task);
+    static ThreadPoolStats get_stats (void);
+};
+
+/* ---------------------------------------------------------------- */
+
+inline bool
+ThreadPoolTask::is_finished (void) const
+{
+  return this->finished;
+}
+
+inline void
+ThreadPoolTask::wait (void)
+{
+  ThreadPool::wait_for(this);
+}
+
+inline sigc::signal<void>&
+ThreadPoolTask::signal_done (void)
+{
+  return this->sig_done;
+}
+
+#endif /* THREAD_POOL_HEADER */
@@ -4,11 +4,13 @@
 #include <gtkmm.h>
 
 #include "api/evetime.h"
+#include "api/apicache.h"
 #include "api/apicerttree.h"
 #include "api/apiskilltree.h"
 #include "bits/config.h"
 #include "util/os.h"
 #include "util/helpers.h"
+#include "util/exception.h"
 #include "gui/guiupdater.h"
 
 #include "config.h"
@@ -24,17 +26,29 @@ UpdaterBase::UpdaterBase (void)
     file.server_host = "api.eveonline.com";
     file.server_path = "/eve/SkillTree.xml.aspx";
     file.local_path = conf_dir + "/" + file.file_name;
+    file.conf_key = "skilltree";
     this->files.push_back(file);
 
     file.file_name = "CertificateTree.xml";
     file.server_host = "api.eveonline.com";
     file.server_path = "/eve/CertificateTree.xml.aspx";
     file.local_path = conf_dir + "/" + file.file_name;
+    file.conf_key = "certtree";
     this->files.push_back(file);
 }
 
 /* ---------------------------------------------------------------- */
 
+Updater::Updater (void)
+{
+    /* Connected first, so the new trees are published before
+     * anybody else is notified about the changed files. */
+    this->sig_dispatch_files_changed.connect(sigc::mem_fun
+        (*this, &Updater::publish_trees));
+}
+
+/* ---------------------------------------------------------------- */
+
 Updater::~Updater (void)
 {
 }
@@ -44,9 +58,6 @@ Updater::~Updater (void)
 bool
 Updater::background_check_intern (void)
 {
-    /* Wait a few seconds before updating. */
-    ::sleep(10);
-
     /* Checke if auto updating is enabled. */
     ConfValuePtr autocheck = Config::conf.get_value("updater.autocheck");
     if (!autocheck->get_bool())
@@ -59,62 +70,108 @@ Updater::background_check_intern (void)
     if (current_time < last_update->get_int() + interval->get_int())
         return false;
 
-    /* Download data files. */
+    /* Wait a few seconds before updating. */
+    ::sleep(10);
+
+    /* Download all data files at once. */
     std::cout << "Updater: Interval expired, "
         << "downloading data files..." << std::endl;
-    std::vector<HttpDataPtr> http_result;
+    std::vector<UpdaterDownload> downloads(this->files.size());
     for (std::size_t i = 0; i < this->files.size(); ++i)
     {
-        /* AsyncHttp is used synchronously, so it doesn't delete itself. */
-        AsyncHttp* fetcher = AsyncHttp::create();
-        Config::setup_http(fetcher, true);
-        fetcher->set_host(this->files[i].server_host);
-        fetcher->set_path(this->files[i].server_path);
-        try
+        UpdaterDownload& dl = downloads[i];
+        dl.file = this->files[i];
+
+        /* Validators are useless without the local file. */
+        if (OS::file_exists(dl.file.local_path.c_str()))
         {
-            http_result.push_back(fetcher->request());
-            delete fetcher;
+            std::string prefix = "updater." + dl.file.conf_key;
+            dl.etag = Config::conf.get_value(prefix + "_etag")->get_string();
+            dl.modified = Config::conf.get_value(prefix + "_modified")
+                ->get_string();
         }
-        catch (std::exception& e)
+
+        dl.pt_create();
+    }
+
+    bool download_error = false;
+    for (std::size_t i = 0; i < downloads.size(); ++i)
+    {
+        downloads[i].pt_join();
+        if (downloads[i].result.get() == 0)
         {
             std::cout << "Updater: Error downloading "
-                << this->files[i].file_name << ": " << e.what() << std::endl;
-            delete fetcher;
-            return false;
+                << downloads[i].file.file_name << ": "
+                << downloads[i].error << std::endl;
+            download_error = true;
         }
     }
+    if (download_error)
+        return false;
 
     /* Compare downloaded files with local files. */
     bool same_files = true;
-    for (std::size_t i = 0; i < this->files.size(); ++i)
+    for (std::size_t i = 0; i < downloads.size(); ++i)
     {
-        std::string file_name = this->files[i].file_name;
-        std::string file_path = this->files[i].local_path;
+        UpdaterDataFile const& file = downloads[i].file;
+        HttpDataPtr result = downloads[i].result;
 
-        if (!Updater::is_same_file(file_path, http_result[i]))
+        if (result->http_code == 304)
         {
-            std::cout << "Updater: " << file_name
+            std::cout << "Updater: " << file.file_name
+                << ": Not modified, ignoring." << std::endl;
+            continue;
+        }
+
+        if (!Updater::is_same_file(file.local_path, result))
+        {
+            std::cout << "Updater: " << file.file_name
                 << ": File changed, updated!" << std::endl;
             same_files = false;
 
-            /* Write new HTTP contents to file. */
-            std::string new_contents;
-            new_contents.insert(new_contents.end(),
-                http_result[i]->data.begin(), http_result[i]->data.end());
-            Helpers::write_file(file_path, new_contents);
-
-            /* Update the corresponding sheet. */
-            if (ApiCertTree::request()->get_filename() == file_path)
-                ApiCertTree::request()->refresh();
-            else if (ApiSkillTree::request()->get_filename() == file_path)
-                ApiSkillTree::request()->refresh();
-            else
-                std::cout << "Updater: File association failed!" << std::endl;
+            /* Write new HTTP contents to a temporary file and replace
+             * the data file, so it is never seen partially written. */
+            std::string tmp_path = file.local_path + ".tmp";
+            try
+            {
+                Helpers::write_file(tmp_path, &result->data[0],
+                    result->data.size());
+                if (!OS::rename_file(tmp_path.c_str(),
+                    file.local_path.c_str()))
+                    throw Exception("Cannot replace " + file.local_path);
+            }
+            catch (Exception& e)
+            {
+                std::cout << "Updater: " << e << std::endl;
+                OS::unlink(tmp_path.c_str());
+                Updater::clear_validators(file);
+                continue;
+            }
+            Updater::set_validators(file, result);
+
+            /* Parse the new tree here, it's published on the main loop.
+             * The GUI keeps using the current tree in the meantime. */
+            try
+            {
+                if (ApiCertTree::get_filename() == file.local_path)
+                    this->new_cert_tree = ApiCertTree::load();
+                else if (ApiSkillTree::get_filename() == file.local_path)
+                    this->new_skill_tree = ApiSkillTree::load();
+                else
+                    std::cout << "Updater: File association failed!"
+                        << std::endl;
+            }
+            catch (Exception& e)
+            {
+                std::cout << "Updater: Cannot parse " << file.file_name
+                    << ": " << e << std::endl;
+            }
         }
         else
         {
-            std::cout << "Updater: " << file_name
+            std::cout << "Updater: " << file.file_name
                 << ": File unchanged, ignoring." << std::endl;
+            Updater::set_validators(file, result);
         }
     }
 
@@ -125,6 +182,43 @@ Updater::background_check_intern (void)
 
 /* ---------------------------------------------------------------- */
 
+void*
+UpdaterDownload::run (void)
+{
+    /* AsyncHttp is used synchronously, so it doesn't delete itself. */
+    AsyncHttp* fetcher = AsyncHttp::create();
+    Config::setup_http(fetcher, true);
+    fetcher->set_host(this->file.server_host);
+    fetcher->set_path(this->file.server_path);
+    if (!this->etag.empty())
+        fetcher->add_header("If-None-Match: " + this->etag);
+    if (!this->modified.empty())
+        fetcher->add_header("If-Modified-Since: " + this->modified);
+
+    try
+    {
+        HttpDataPtr data = fetcher->request();
+        if (data->http_code == 200 || data->http_code == 304)
+            this->result = data;
+        else
+            this->error = "HTTP status " + Helpers::get_string_from_int
+                (data->http_code);
+    }
+    catch (Exception& e)
+    {
+        this->error = e;
+    }
+    catch (std::exception& e)
+    {
+        this->error = e.what();
+    }
+
+    delete fetcher;
+    return NULL;
+}
+
+/* ================================================================ */
+
 void
 Updater::background_check (void)
 {
@@ -136,6 +230,20 @@ Updater::background_check (void)
 
 /* ---------------------------------------------------------------- */
 
+void
+Updater::publish_trees (void)
+{
+    if (this->new_skill_tree.get() != 0)
+        ApiSkillTree::publish(this->new_skill_tree);
+    if (this->new_cert_tree.get() != 0)
+        ApiCertTree::publish(this->new_cert_tree);
+
+    this->new_skill_tree.reset();
+    this->new_cert_tree.reset();
+}
+
+/* ---------------------------------------------------------------- */
+
 void
 Updater::background_check_async (void)
 {
@@ -185,67 +293,53 @@ Updater::set_last_update_now (void)
 
 /* ---------------------------------------------------------------- */
 
+void
+Updater::set_validators (UpdaterDataFile const& file, HttpDataPtr data)
+{
+    std::string etag = data->get_header("ETag");
+    std::string modified = data->get_header("Last-Modified");
+
+    /* The config file format cannot store comments in values. */
+    if (etag.find('#') != std::string::npos)
+        etag.clear();
+
+    std::string prefix = "updater." + file.conf_key;
+    Config::conf.get_value(prefix + "_etag")->set(etag);
+    Config::conf.get_value(prefix + "_modified")->set(modified);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+Updater::clear_validators (UpdaterDataFile const& file)
+{
+    std::string prefix = "updater." + file.conf_key;
+    Config::conf.get_value(prefix + "_etag")->set(std::string());
+    Config::conf.get_value(prefix + "_modified")->set(std::string());
+}
+
+/* ---------------------------------------------------------------- */
+
 bool
 Updater::is_same_file (std::string const& filename, HttpDataPtr data)
 {
-    /* Read file. */
-    std::string file_contents;
-    try
-    { Helpers::read_file(filename, &file_contents); }
-    catch (...)
+    /* Map the file instead of reading it into memory. */
+    std::size_t size = 0;
+    char const* contents = (char const*)OS::map_file(filename.c_str(), &size);
+    if (contents == 0)
     {
         std::cout << "File compare: Cannot read file!" << std::endl;
         return false;
     }
 
-    /* Compare file size. */
-    if (file_contents.size() != data->data.size())
-    {
-        std::cout << "File compare: Size differs: "
-            << file_contents.size() << " vs " << data->data.size()
-            << std::endl;
-        return false;
-    }
-
     /*
-     * Compare file content. Since <currentTime> changes every time,
-     * this tag must be ignored.
+     * Compare digests of the contents. Since <currentTime> and
+     * <cachedUntil> change every time, the digest ignores these tags.
      */
-    std::vector<std::pair<std::string, std::size_t> > ignore_list;
-    ignore_list.push_back(std::make_pair(std::string("<currentTime>"), 0));
-    ignore_list.push_back(std::make_pair(std::string("<cachedUntil>"), 0));
-    std::string ignore_end = "</";
-    std::size_t ignore_end_pos = 0;
-    bool ignore_bytes = false;
-    for (std::size_t i = 0; i < file_contents.size(); ++i)
-    {
-        for (std::size_t j = 0; !ignore_bytes && j < ignore_list.size(); ++j)
-        {
-            if (ignore_list[j].first[ignore_list[j].second] == file_contents[i])
-                ignore_list[j].second += 1;
-            else
-                ignore_list[j].second = 0;
-
-            if (ignore_list[j].second == ignore_list[j].first.size())
-                ignore_bytes = true;
-        }
-
-        if (ignore_bytes && ignore_end[ignore_end_pos] == file_contents[i])
-            ignore_end_pos += 1;
-        else
-            ignore_end_pos = 0;
-        if (ignore_end_pos == ignore_end.size())
-        {
-            ignore_bytes = false;
-            continue;
-        }
-
-        if (ignore_bytes)
-            continue;
-
-        if (file_contents[i] != data->data[i])
-            return false;
-    }
+    uint64_t file_digest = ApiCache::get_digest(contents, size);
+    OS::unmap_file((void*)contents, size);
+    uint64_t data_digest = ApiCache::get_digest(&data->data[0],
+        data->data.size());
 
-    return true;
+    return file_digest == data_digest;
 }
@@ -18,6 +18,8 @@
 
 #include "util/thread.h"
 #include "net/http.h"
+#include "api/apiskilltree.h"
+#include "api/apicerttree.h"
 
 /*
  * Information about the data files updated by the GtkEveMon updater.
@@ -32,6 +34,29 @@ struct UpdaterDataFile
     std::string server_host;
     std::string server_path;
     std::string local_path;
+    /* Prefix of the config keys that store the HTTP validators. */
+    std::string conf_key;
+};
+
+/* ---------------------------------------------------------------- */
+
+/*
+ * Downloads a single data file in its own thread. The request is
+ * conditional if validators for the local file are known, so that
+ * the server answers with 304 if the file did not change.
+ */
+class UpdaterDownload : public Thread
+{
+protected:
+    void* run (void);
+
+public:
+    UpdaterDataFile file;
+    std::string etag;
+    std::string modified;
+
+    HttpDataPtr result;
+    std::string error;
 };
 
 /* ---------------------------------------------------------------- */
@@ -63,12 +88,17 @@ private:
     Glib::Dispatcher sig_dispatch_files_changed;
     Glib::Dispatcher sig_dispatch_files_unchanged;
 
+    /* Trees parsed by the updater thread, published on the main loop. */
+    ApiSkillTreePtr new_skill_tree;
+    ApiCertTreePtr new_cert_tree;
+
 protected:
     void* run (void);
     bool background_check_intern (void);
+    void publish_trees (void);
 
 public:
-    Updater (void) {}
+    Updater (void);
     virtual ~Updater (void);
 
     /*
@@ -93,9 +123,23 @@ public:
      */
     static void set_last_update_now (void);
 
+    /*
+     * Stores the ETag and Last-Modified headers of the download for
+     * conditional requests of the background updater. Only call this
+     * once the local file matches the download.
+     */
+    static void set_validators (UpdaterDataFile const& file,
+        HttpDataPtr data);
+
+    /*
+     * Forgets the validators of the file, so the next request is not
+     * conditional. Used when the local file could not be written.
+     */
+    static void clear_validators (UpdaterDataFile const& file);
+
     /*
      * Checks whether the given filename has the same contents as
-     * the downloaded HTTP data.
+     * the downloaded HTTP data, ignoring <currentTime> and <cachedUntil>.
      */
     static bool is_same_file (std::string const& filename, HttpDataPtr data);
 
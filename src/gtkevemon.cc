@@ -15,14 +15,20 @@
 
 #include <gtkmm.h>
 
+#include "api/apicache.h"
+#include "api/apischeduler.h"
 #include "api/evetime.h"
 #include "bits/argumentsettings.h"
 #include "bits/serverlist.h"
+#include "bits/threadpool.h"
 #include "bits/config.h"
 #include "bits/server.h"
 #include "bits/updater.h"
 #include "gui/imagestore.h"
 #include "gui/maingui.h"
+#include "gui/portraitservice.h"
+#include "net/curlpool.h"
+#include "net/httpengine.h"
 
 void
 signal_received (int /*signum*/)
@@ -41,6 +47,8 @@ main (int argc, char* argv[])
 #endif
 
   Gtk::Main kit(&argc, &argv);
+  CurlPool::init();
+  ThreadPool::init();
   ArgumentSettings::init(argc, argv);
   Config::init_defaults();
   Config::init_config_path();
@@ -61,9 +69,15 @@ main (int argc, char* argv[])
     kit.run();
   }
 
+  ThreadPool::unload();
   EveTime::store_to_config();
   ServerList::unload();
+  PortraitService::unload();
   ImageStore::unload();
+  EveApiScheduler::unload();
+  ApiCache::unload();
+  HttpEngine::unload();
+  CurlPool::unload();
 
   Config::unload();
 
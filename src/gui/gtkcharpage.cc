@@ -8,6 +8,7 @@
 // You should have received a copy of the GNU General Public License
 // along with GtkEveMon. If not, see <http://www.gnu.org/licenses/>.
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 
@@ -21,6 +22,7 @@
 #include "bits/config.h"
 #include "bits/notifier.h"
 #include "bits/characterlist.h"
+#include "bits/refreshtimer.h"
 
 #include "imagestore.h"
 #include "gtkdefines.h"
@@ -32,7 +34,9 @@
 GtkCharPage::GtkCharPage (CharacterPtr character)
   : Gtk::Box(Gtk::ORIENTATION_VERTICAL, 5),
     character(character),
-    info_display(INFO_STYLE_TOP_HSEP)
+    info_display(INFO_STYLE_TOP_HSEP),
+    refresh_timer(0),
+    cached_timer(0)
 {
   /* Setup GUI. */
   this->char_image.set_enable_clicks();
@@ -261,13 +265,10 @@ GtkCharPage::GtkCharPage (CharacterPtr character)
       &GtkCharPage::on_live_sp_value_update), CHARPAGE_LIVE_SP_LABEL_UPDATE);
   Glib::signal_timeout().connect(sigc::mem_fun(*this,
       &GtkCharPage::on_live_sp_image_update), CHARPAGE_LIVE_SP_IMAGE_UPDATE);
-  Glib::signal_timeout().connect(sigc::mem_fun(*this,
-      &GtkCharPage::check_expired_sheets), CHARPAGE_CHECK_EXPIRED_SHEETS);
-  Glib::signal_timeout().connect(sigc::mem_fun(*this,
-      &GtkCharPage::update_cached_duration), CHARPAGE_UPDATE_CACHED_DURATION);
 
   /* Request data update and update GUI. */
   this->request_documents();
+  this->schedule_refresh();
   this->char_image.set(this->character->get_char_id());
   this->update_charsheet_details();
   this->update_training_details();
@@ -278,6 +279,14 @@ GtkCharPage::GtkCharPage (CharacterPtr character)
 
 /* ---------------------------------------------------------------- */
 
+GtkCharPage::~GtkCharPage (void)
+{
+  RefreshTimer::cancel(this->refresh_timer);
+  RefreshTimer::cancel(this->cached_timer);
+}
+
+/* ---------------------------------------------------------------- */
+
 void
 GtkCharPage::update_charsheet_details (void)
 {
@@ -458,30 +467,27 @@ GtkCharPage::update_training_details (void)
 
 /* ---------------------------------------------------------------- */
 
-/* Create a data structure that maps the group ID to the iterator of
- * the group, skill points for that group and the amount of skills.
- * This is needed for building the skill list. */
+/* Skill points and amount of skills per group, collected while
+ * patching the skill list. */
 struct SkillGroupInfo
 {
-  Gtk::TreeModel::iterator iter;
   int sp;
-  bool empty;
-  int max;
+  unsigned int skills;
 
-  SkillGroupInfo (Gtk::TreeModel::iterator iter)
-      : iter(iter), sp(0), empty(true) {}
+  SkillGroupInfo (void) : sp(0), skills(0) {}
 };
-typedef std::map<int, SkillGroupInfo> IterMapType;
+typedef std::map<int, SkillGroupInfo> GroupInfoMap;
 
 /* ---------------------------------------------------------------- */
 
 void
 GtkCharPage::update_skill_list (void)
 {
-  this->skill_store->clear();
-
   if (!this->character->cs->valid)
+  {
+    this->clear_skill_list();
     return;
+  }
 
   /* Load the skill tree. */
   ApiSkillTreePtr tree;
@@ -491,10 +497,26 @@ GtkCharPage::update_skill_list (void)
   }
   catch (Exception& e)
   {
+    this->clear_skill_list();
     this->on_skilltree_error(e);
     return;
   }
 
+  /* A new skill tree may rename skills and groups. Start over and
+   * compute the max points per skill group once per tree. */
+  if (tree != this->skill_rows_tree)
+  {
+    this->clear_skill_list();
+    this->skill_rows_tree = tree;
+    this->group_max_sp.clear();
+    for (std::size_t i = 0; i < tree->skills.size(); ++i)
+    {
+      ApiSkill const& skill = tree->skills[i];
+      this->group_max_sp[skill.group]
+          += ApiCharSheet::calc_dest_sp(4, skill.rank);
+    }
+  }
+
   /* Cache skill in training. */
   ApiSkill skill_training;
   skill_training.id = -1;
@@ -502,115 +524,204 @@ GtkCharPage::update_skill_list (void)
   if (this->character->is_training() && this->character->training_skill != 0)
     skill_training = *this->character->training_skill;
 
-  /* Append all groups to the store. Save their iterators for the children.
-   * Format is <group_id, <model iter, group sp> >. */
-  IterMapType iter_map;
-  for (ApiSkillGroupMap::iterator iter = tree->groups.begin();
-      iter != tree->groups.end(); iter++)
-  {
-    std::string name = iter->second.name;
-    if (skill_training.group == iter->first)
-      name += "  <i>(1 in training)</i>";
-
-    Gtk::TreeModel::iterator siter = this->skill_store->append();
-    (*siter)[this->skill_cols.id] = -1;
-    (*siter)[this->skill_cols.skill] = 0;
-    (*siter)[this->skill_cols.name] = name;
-    (*siter)[this->skill_cols.icon] = ImageStore::skillicons[0];
-    iter_map.insert(std::make_pair(iter->first, SkillGroupInfo(siter)));
-  }
-
-  /* Compute max points per skill group. */
-  for (ApiSkillMap::iterator iter = tree->skills.begin();
-       iter != tree->skills.end(); iter++)
-  {
-    IterMapType::iterator iiter = iter_map.find(iter->second.group);
-    if (iiter != iter_map.end())
-    {
-      iiter->second.max += ApiCharSheet::calc_dest_sp(4, iter->second.rank);
-    }
-  }
+  for (SkillRowMap::iterator iter = this->skill_rows.begin();
+      iter != this->skill_rows.end(); iter++)
+    iter->second.present = false;
 
-  /* Append all skills to the skill groups. */
+  /* Patch the skill rows. Groups are added with their first skill. */
+  GroupInfoMap group_info;
   std::vector<ApiCharSheetSkill>& skills = this->character->cs->skills;
   for (unsigned int i = 0; i < skills.size(); ++i)
   {
     /* Get skill object. */
     ApiSkill const& skill = *skills[i].details;
 
-    /* Lookup skill group. */
-    IterMapType::iterator iiter = iter_map.find(skill.group);
-    if (iiter == iter_map.end())
+    GroupRowMap::iterator giter = this->group_rows.find(skill.group);
+    if (giter == this->group_rows.end())
     {
-      std::cout << "Error appending skill, unknown group!" << std::endl;
-      continue;
+      /* Lookup skill group. */
+      ApiSkillGroupMap::iterator group = tree->groups.find(skill.group);
+      if (group == tree->groups.end())
+      {
+        std::cout << "Error appending skill, unknown group!" << std::endl;
+        continue;
+      }
+
+      Gtk::TreeModel::iterator siter = this->skill_store->append();
+      (*siter)[this->skill_cols.id] = -1;
+      (*siter)[this->skill_cols.skill] = 0;
+      (*siter)[this->skill_cols.name] = group->second.name;
+      (*siter)[this->skill_cols.icon] = ImageStore::skillicons[0];
+      (*siter)[this->skill_cols.max_points] = Helpers::get_dotted_str_from_int
+          (this->group_max_sp[skill.group]);
+
+      GroupRow row;
+      row.iter = siter;
+      row.sp = -1;
+      row.training = false;
+      giter = this->group_rows.insert(std::make_pair(skill.group, row)).first;
     }
 
-    /* Append a new row. */
-    Gtk::TreeModel::iterator iter = this->skill_store->append
-        (iiter->second.iter->children());
-
-    /* Get skill name and set icon. */
-    std::string skill_name = skill.name + " ("
-        + Helpers::get_string_from_int(skill.rank) + ")";
-
-    if (skill.id == skill_training.id)
+    SkillRowMap::iterator riter = this->skill_rows.find(skill.id);
+    if (riter == this->skill_rows.end())
     {
-      skill_name += "  <i>(in training)</i>";
-      (*iter)[this->skill_cols.icon] = ImageStore::skillicons[2];
-
-      /* Update of the SkillInTrainingInfo. */
-      this->tree_skill_iter = iter;
-    }
-    else
-    {
-      if (skills[i].points != skills[i].points_start)
-        (*iter)[this->skill_cols.icon] = ImageStore::skillicons[4];
-      else if (skills[i].level < 5)
-        (*iter)[this->skill_cols.icon] = ImageStore::skillicons[1];
-      else
-        (*iter)[this->skill_cols.icon] = ImageStore::skillicons[3];
+      /* Append a new row. */
+      Gtk::TreeModel::iterator iter = this->skill_store->append
+          (giter->second.iter->children());
+      (*iter)[this->skill_cols.id] = skill.id;
+      (*iter)[this->skill_cols.primary]
+          = ApiSkillTree::get_attrib_short_name(skill.primary);
+      (*iter)[this->skill_cols.secondary]
+          = ApiSkillTree::get_attrib_short_name(skill.secondary);
+
+      /* Invalid values force all other columns to be written. */
+      SkillRow row;
+      row.iter = iter;
+      row.skill = 0;
+      row.points = -1;
+      row.points_max = -1;
+      row.training = (skill.id != skill_training.id);
+      riter = this->skill_rows.insert(std::make_pair(skill.id, row)).first;
     }
 
-    /* Set skill id, points and name. */
-    (*iter)[this->skill_cols.id] = skill.id;
-    (*iter)[this->skill_cols.skill] = &skills[i];
-    (*iter)[this->skill_cols.points]
-        = Helpers::get_dotted_str_from_int(skills[i].points);
-    (*iter)[this->skill_cols.max_points]
-        = Helpers::get_dotted_str_from_int(skills[i].points_max);
+    bool training = (skill.id == skill_training.id);
+    this->update_skill_row(riter->second, &skills[i], training);
 
-    (*iter)[this->skill_cols.name] = skill_name;
-    (*iter)[this->skill_cols.level] = ImageStore::skill_progress
-        (skills[i].level, skills[i].completed);
-    (*iter)[this->skill_cols.primary] = ApiSkillTree::get_attrib_short_name(skills[i].details->primary);
-    (*iter)[this->skill_cols.secondary] = ApiSkillTree::get_attrib_short_name(skills[i].details->secondary);
+    /* Update of the SkillInTrainingInfo. */
+    if (training)
+      this->tree_skill_iter = riter->second.iter;
 
     /* Update group info. */
-    iiter->second.sp += skills[i].points;
-    iiter->second.empty = false;
+    SkillGroupInfo& info = group_info[skill.group];
+    info.sp += skills[i].points;
+    info.skills += 1;
+  }
+
+  /* Remove skills the character no longer has. */
+  for (SkillRowMap::iterator iter = this->skill_rows.begin();
+      iter != this->skill_rows.end();)
+  {
+    if (iter->second.present)
+    {
+      iter++;
+      continue;
+    }
+
+    this->skill_store->erase(iter->second.iter);
+    this->skill_rows.erase(iter++);
   }
 
   /* Update the skillpoints for the groups. */
-  for (IterMapType::iterator iter = iter_map.begin();
-      iter != iter_map.end(); iter++)
+  for (GroupRowMap::iterator iter = this->group_rows.begin();
+      iter != this->group_rows.end();)
   {
     /* Remove group with no skills. */
-    if (iter->second.empty)
+    GroupInfoMap::iterator info = group_info.find(iter->first);
+    if (info == group_info.end())
     {
       this->skill_store->erase(iter->second.iter);
+      this->group_rows.erase(iter++);
       continue;
     }
 
-    (*iter->second.iter)[this->skill_cols.points]
-        = Helpers::get_dotted_str_from_int(iter->second.sp);
+    GroupRow& row = iter->second;
+    if (row.sp != info->second.sp)
+    {
+      row.sp = info->second.sp;
+      (*row.iter)[this->skill_cols.points]
+          = Helpers::get_dotted_str_from_int(row.sp);
+    }
 
-    (*iter->second.iter)[this->skill_cols.max_points]
-        = Helpers::get_dotted_str_from_int(iter->second.max);
+    bool training = (iter->first == skill_training.group);
+    if (row.training != training)
+    {
+      row.training = training;
+      std::string name = tree->groups[iter->first].name;
+      if (training)
+        name += "  <i>(1 in training)</i>";
+      (*row.iter)[this->skill_cols.name] = name;
+    }
 
     /* Update of the SkillInTrainingInfo. */
-    if (iter->first == skill_training.group)
-      this->tree_group_iter = iter->second.iter;
+    if (training)
+      this->tree_group_iter = row.iter;
+
+    iter++;
+  }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+GtkCharPage::clear_skill_list (void)
+{
+  this->skill_store->clear();
+  this->skill_rows.clear();
+  this->group_rows.clear();
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+GtkCharPage::update_skill_row (SkillRow& row, ApiCharSheetSkill* cskill,
+    bool training)
+{
+  ApiSkill const& skill = *cskill->details;
+  row.present = true;
+
+  /* Only columns with changed values are written. */
+  if (row.skill != cskill)
+  {
+    row.skill = cskill;
+    (*row.iter)[this->skill_cols.skill] = cskill;
+  }
+
+  if (row.points != cskill->points)
+  {
+    row.points = cskill->points;
+    (*row.iter)[this->skill_cols.points]
+        = Helpers::get_dotted_str_from_int(row.points);
+  }
+
+  if (row.points_max != cskill->points_max)
+  {
+    row.points_max = cskill->points_max;
+    (*row.iter)[this->skill_cols.max_points]
+        = Helpers::get_dotted_str_from_int(row.points_max);
+  }
+
+  /* Progress icons are shared, equal icons are the same pixbuf. */
+  Glib::RefPtr<Gdk::Pixbuf> level = ImageStore::skill_progress
+      (cskill->level, cskill->completed);
+  if (row.level != level)
+  {
+    row.level = level;
+    (*row.iter)[this->skill_cols.level] = level;
+  }
+
+  Glib::RefPtr<Gdk::Pixbuf> icon;
+  if (training)
+    icon = ImageStore::skillicons[2];
+  else if (cskill->points != cskill->points_start)
+    icon = ImageStore::skillicons[4];
+  else if (cskill->level < 5)
+    icon = ImageStore::skillicons[1];
+  else
+    icon = ImageStore::skillicons[3];
+  if (row.icon != icon)
+  {
+    row.icon = icon;
+    (*row.iter)[this->skill_cols.icon] = icon;
+  }
+
+  if (row.training != training)
+  {
+    row.training = training;
+    std::string skill_name = skill.name + " ("
+        + Helpers::get_string_from_int(skill.rank) + ")";
+    if (training)
+      skill_name += "  <i>(in training)</i>";
+    (*row.iter)[this->skill_cols.name] = skill_name;
   }
 }
 
@@ -687,31 +798,57 @@ GtkCharPage::request_documents (void)
 
 /* ---------------------------------------------------------------- */
 
-bool
+void
 GtkCharPage::check_expired_sheets (void)
 {
+  this->refresh_timer = 0;
+
   /* Check if automatic update is enabled. */
   ConfValuePtr value = Config::conf.get_value("settings.auto_update_sheets");
-  if (!value->get_bool())
-    return true;
-
   ApiCharSheetPtr cs = this->character->cs;
   ApiSkillQueuePtr sq = this->character->sq;
 
   /* Skip automatic update if both sheets are cached. */
-  if (sq->is_locally_cached() && cs->is_locally_cached())
-    return true;
+  if (value->get_bool()
+      && (!sq->is_locally_cached() || !cs->is_locally_cached()))
+  {
+    time_t evetime = EveTime::get_eve_time();
+
+    /* Check which docs to re-request. */
+    if (!sq->valid || evetime >= sq->get_cached_until_t()
+        || !cs->valid || evetime >= cs->get_cached_until_t())
+      this->request_documents();
+  }
 
-  //std::cout << "Checking for expired sheets..." << std::endl;
+  /* Check again later in case the request doesn't succeed. */
+  this->schedule_refresh();
+}
+
+/* ---------------------------------------------------------------- */
 
+void
+GtkCharPage::schedule_refresh (void)
+{
   time_t evetime = EveTime::get_eve_time();
+  ApiCharSheetPtr cs = this->character->cs;
+  ApiSkillQueuePtr sq = this->character->sq;
 
-  /* Check which docs to re-request. */
-  if (!sq->valid || evetime >= sq->get_cached_until_t()
-      || !cs->valid || evetime >= cs->get_cached_until_t())
-    this->request_documents();
+  /* Wake up shortly after the first sheet expires. If a sheet could
+   * not be fetched from the API, retry after a while. */
+  time_t delay;
+  if (!cs->valid || cs->is_locally_cached()
+      || cs->get_cached_until_t() <= evetime
+      || !sq->valid || sq->is_locally_cached()
+      || sq->get_cached_until_t() <= evetime)
+    delay = CHARPAGE_REFRESH_RETRY;
+  else
+    delay = std::min(cs->get_cached_until_t(), sq->get_cached_until_t())
+        - evetime + CHARPAGE_REFRESH_DELAY;
+  delay = std::min(delay, (time_t)CHARPAGE_REFRESH_MAX_DELAY);
 
-  return true;
+  this->refresh_timer = RefreshTimer::schedule(this->refresh_timer,
+      (uint64_t)delay * 1000, sigc::mem_fun(*this,
+      &GtkCharPage::check_expired_sheets));
 }
 
 /* ---------------------------------------------------------------- */
@@ -732,6 +869,7 @@ GtkCharPage::api_info_changed (void)
   }
 
   /* Update the char sheet and training sheet info. */
+  this->schedule_refresh();
   this->update_cached_duration();
   this->update_charsheet_details();
   this->update_training_details();
@@ -741,13 +879,16 @@ GtkCharPage::api_info_changed (void)
 
 /* ---------------------------------------------------------------- */
 
-bool
+void
 GtkCharPage::update_cached_duration (void)
 {
   time_t current = EveTime::get_eve_time();
   ApiCharSheetPtr cs = this->character->cs;
   ApiSkillQueuePtr sq = this->character->sq;
 
+  /* Seconds until one of the labels changes, 0 if none will. */
+  time_t next_change = 0;
+
   if (sq->valid)
   {
     time_t cached_until = sq->get_cached_until_t();
@@ -755,8 +896,13 @@ GtkCharPage::update_cached_duration (void)
     if (sq->is_locally_cached())
       this->skillqueue_info_label.set_text("Locally cached!");
     else if (cached_until > current)
+    {
       this->skillqueue_info_label.set_text(EveTime::get_minute_str_for_diff
           (cached_until - current) + " cached");
+      time_t change = (cached_until - current - 1) % 60 + 1;
+      if (next_change == 0 || change < next_change)
+        next_change = change;
+    }
     else
       this->skillqueue_info_label.set_text("Ready for update!");
   }
@@ -768,13 +914,29 @@ GtkCharPage::update_cached_duration (void)
     if (cs->is_locally_cached())
       this->charsheet_info_label.set_text("Locally cached!");
     else if (cached_until > current)
+    {
       this->charsheet_info_label.set_text(EveTime::get_minute_str_for_diff
           (cached_until - current) + " cached");
+      time_t change = (cached_until - current - 1) % 60 + 1;
+      if (next_change == 0 || change < next_change)
+        next_change = change;
+    }
     else
       this->charsheet_info_label.set_text("Ready for update!");
   }
 
-  return true;
+  /* Update the labels again when the displayed minute changes. */
+  if (next_change == 0)
+  {
+    RefreshTimer::cancel(this->cached_timer);
+    this->cached_timer = 0;
+  }
+  else
+  {
+    this->cached_timer = RefreshTimer::schedule(this->cached_timer,
+        (uint64_t)next_change * 1000, sigc::mem_fun(*this,
+        &GtkCharPage::update_cached_duration));
+  }
 }
 
 /* ---------------------------------------------------------------- */
@@ -1049,6 +1211,9 @@ GtkCharPage::on_api_error (EveApiDocType dt, std::string msg, bool cached)
 
   std::cout << "Error: Failed to request " << doc << ": " << msg << std::endl;
 
+  /* Retry later unless the other sheet expires earlier. */
+  this->schedule_refresh();
+
   InfoItemType info_type;
   std::string heading;
   if (cached)
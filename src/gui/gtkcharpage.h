@@ -11,6 +11,7 @@
 #ifndef GTK_CHAR_PAGE_HEADER
 #define GTK_CHAR_PAGE_HEADER
 
+#include <map>
 #include <string>
 
 #include <gdkmm.h>
@@ -25,10 +26,13 @@
 #define CHARPAGE_LIVE_SP_LABEL_UPDATE 1000
 /* Update the live SP image every this milli seconds. */
 #define CHARPAGE_LIVE_SP_IMAGE_UPDATE 60000
-/* Check for expired sheets every this milli seconds. */
-#define CHARPAGE_CHECK_EXPIRED_SHEETS 600000
-/* Update the cached duration this milli seconds. */
-#define CHARPAGE_UPDATE_CACHED_DURATION 25000
+/* Request sheets this many seconds after they expired. */
+#define CHARPAGE_REFRESH_DELAY 3
+/* Retry failed or locally cached sheets after this many seconds. */
+#define CHARPAGE_REFRESH_RETRY 120
+/* Check the sheets at least every this many seconds. The refresh timer
+ * stops during suspend, the EVE time picked up on each check doesn't. */
+#define CHARPAGE_REFRESH_MAX_DELAY 600
 
 class GtkCharSkillsCols : public Gtk::TreeModel::ColumnRecord
 {
@@ -51,6 +55,29 @@ class GtkCharSkillsCols : public Gtk::TreeModel::ColumnRecord
 class GtkCharPage : public Gtk::Box
 {
   private:
+    /* Skill list rows with the values they currently show. */
+    struct SkillRow
+    {
+      Gtk::TreeIter iter;
+      ApiCharSheetSkill* skill;
+      int points;
+      int points_max;
+      Glib::RefPtr<Gdk::Pixbuf> level;
+      Glib::RefPtr<Gdk::Pixbuf> icon;
+      bool training;
+      bool present;
+    };
+
+    struct GroupRow
+    {
+      Gtk::TreeIter iter;
+      int sp;
+      bool training;
+    };
+
+    typedef std::map<int, SkillRow> SkillRowMap;
+    typedef std::map<int, GroupRow> GroupRowMap;
+
     /* Character to be monitored. */
     CharacterPtr character;
 
@@ -89,15 +116,31 @@ class GtkCharPage : public Gtk::Box
     Gtk::TreeIter tree_skill_iter;
     Gtk::TreeIter tree_group_iter;
 
+    /* Rows of the skill list by skill and group ID. The skill list is
+     * patched in place and only changed rows are written. */
+    SkillRowMap skill_rows;
+    GroupRowMap group_rows;
+    /* Skill tree the rows were built from and max SP per group. */
+    ApiSkillTreePtr skill_rows_tree;
+    std::map<int, int> group_max_sp;
+
+    /* Timers for sheet expiry and the cached duration labels. */
+    unsigned int refresh_timer;
+    unsigned int cached_timer;
+
     /* Helpers, signal handlers, etc. */
     void update_charsheet_details (void);
     void update_training_details (void);
     void update_skill_list (void);
+    void clear_skill_list (void);
+    void update_skill_row (SkillRow& row, ApiCharSheetSkill* cskill,
+        bool training);
     void delete_skill_completed_dialog (int response, Gtk::Widget* widget);
 
     /* Request and process EVE API documents. */
     void request_documents (void);
-    bool check_expired_sheets (void);
+    void check_expired_sheets (void);
+    void schedule_refresh (void);
 
     /* Error dialogs. */
     void on_skilltree_error (std::string const& e);
@@ -107,7 +150,7 @@ class GtkCharPage : public Gtk::Box
 
     /* Misc GUI stuff. */
     bool update_remaining (void);
-    bool update_cached_duration (void);
+    void update_cached_duration (void);
     void api_info_changed (void);
     void remove_tray_notify (void);
     void create_tray_notify (void);
@@ -126,6 +169,7 @@ class GtkCharPage : public Gtk::Box
 
   public:
     GtkCharPage (CharacterPtr character);
+    ~GtkCharPage (void);
 
     CharacterPtr get_character (void) const;
     void set_parent_window (Gtk::Window* parent);
@@ -251,7 +251,7 @@ GtkSkillBrowser::fill_store (void)
   Glib::ustring filter = this->filter_entry.get_text();
 
   ApiSkillTreePtr tree = ApiSkillTree::request();
-  ApiSkillMap& skills = tree->skills;
+  ApiSkillList& skills = tree->skills;
   ApiSkillGroupMap& groups = tree->groups;
 
   typedef Gtk::TreeModel::iterator GtkTreeModelIter;
@@ -285,10 +285,9 @@ GtkSkillBrowser::fill_store (void)
   bool only_published = !Config::conf.get_value(unpublished_cfg)->get_bool();
 
   /* Append all skills to the skill groups. */
-  for (ApiSkillMap::iterator iter = skills.begin();
-      iter != skills.end(); iter++)
+  for (std::size_t i = 0; i < skills.size(); ++i)
   {
-    ApiSkill& skill = iter->second;
+    ApiSkill& skill = skills[i];
 
     /* Filter non-public skills if so requested */
     if (only_published && !skill.published)
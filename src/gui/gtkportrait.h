@@ -16,31 +16,20 @@
 #include <gdkmm.h>
 #include <gtkmm.h>
 
-#include "net/asynchttp.h"
-
 /* The size of the portrait (pixels) in the GUI. */
 #define PORTRAIT_SIZE 85
 
+/* Shows the portrait of a character. Portraits are provided by the
+ * PortraitService and shared by all widgets. */
 class GtkPortrait : public Gtk::EventBox
 {
   private:
     Gtk::Image image;
     std::string char_id;
-    sigc::connection http_request;
+    sigc::connection portrait_request;
 
-    bool fetch_from_gtkevemon_cache (void);
-    void request_from_eve_online (void);
-    void set_from_eve_online (AsyncHttpData result);
+    void on_portrait_ready (void);
     bool on_button_press_myevent (GdkEventButton* event);
-    std::string get_portrait_dir (void);
-    std::string get_portrait_file (void);
-
-    void cache_portrait (Glib::RefPtr<Gdk::Pixbuf> portrait);
-
-  private:
-    static Glib::RefPtr<Gdk::Pixbuf> create_from_file (std::string const& fn);
-    static void save_to_file (Glib::RefPtr<Gdk::Pixbuf> pixbuf,
-        std::string const& fn);
 
   public:
     GtkPortrait (void);
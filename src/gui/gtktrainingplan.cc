@@ -9,6 +9,8 @@
 // along with GtkEveMon. If not, see <http://www.gnu.org/licenses/>.
 
 #include <iostream>
+#include <sstream>
+#include <algorithm>
 
 #include <gtkmm.h>
 
@@ -27,6 +29,70 @@
 GtkSkillList::GtkSkillList (void)
 {
   this->total_plan_sp = 0;
+  this->dirty_from = 0;
+  this->calc_size = 0;
+  this->calc_active_spph = false;
+  this->calc_char_sp = 0;
+  this->calc_char_skills = 0;
+  this->calc_train_skill = -1;
+  this->calc_train_level = -1;
+  this->calc_train_end = 0;
+  this->calc_train_spph = 0;
+  this->index_size = 0;
+  this->index_valid = false;
+  this->positions_valid = false;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+GtkSkillList::update_index (bool positions)
+{
+  /* A different size means the list has been modified directly. */
+  if (!this->index_valid || this->index_size != this->size())
+  {
+    this->plan_requires.clear();
+    for (std::size_t i = 0; i < this->size(); ++i)
+      this->count_requires(this->at(i), 1);
+
+    this->index_size = this->size();
+    this->index_valid = true;
+    this->positions_valid = false;
+  }
+
+  if (positions && !this->positions_valid)
+  {
+    /* Duplicates keep the first position. */
+    this->plan_positions.clear();
+    for (std::size_t i = 0; i < this->size(); ++i)
+      this->plan_positions.insert(this->get_plan_key
+          (this->at(i).skill->id, this->at(i).plan_level), (int)i);
+
+    this->positions_valid = true;
+  }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+GtkSkillList::count_requires (GtkSkillInfo const& info, int delta)
+{
+  ApiSkill const* skill = info.skill;
+
+  /* Every skill requires its previous level and the skill deps. */
+  for (std::size_t i = 0; i <= skill->deps.size(); ++i)
+  {
+    int key;
+    if (i < skill->deps.size())
+      key = this->get_plan_key(skill->deps[i].first, skill->deps[i].second);
+    else if (info.plan_level > 1)
+      key = this->get_plan_key(skill->id, info.plan_level - 1);
+    else
+      break;
+
+    int count = std::max(0, this->plan_requires.find(key));
+    this->plan_requires.set(key, count + delta);
+  }
 }
 
 /* ---------------------------------------------------------------- */
@@ -70,7 +136,17 @@ GtkSkillList::append_skill (ApiSkill const* skill, int level, bool objective)
     this->append_skill(skill, level - 1, false);
   }
 
+  /* Appending keeps all positions, so the index can be updated. */
+  this->update_index(false);
+  if (this->positions_valid)
+    this->plan_positions.insert(this->get_plan_key(skill->id, level),
+        (int)this->size());
+  this->count_requires(info, 1);
+
+  this->dirty_from = std::min(this->dirty_from, (unsigned int)this->size());
   this->push_back(info);
+  this->calc_size += 1;
+  this->index_size += 1;
 }
 
 /* ---------------------------------------------------------------- */
@@ -104,8 +180,9 @@ GtkSkillList::append_cert (ApiCert const* cert)
 void
 GtkSkillList::move_skill (unsigned int from, unsigned int to)
 {
-  this->insert_skill(to, GtkSkillInfo());
-  this->at(to) = this->at(from);
+  /* The "from" index is given as if the skill was inserted at "to". */
+  GtkSkillInfo info = this->at(from > to ? from - 1 : from);
+  this->insert_skill(to, info);
   this->delete_skill(from);
 }
 
@@ -114,7 +191,14 @@ GtkSkillList::move_skill (unsigned int from, unsigned int to)
 void
 GtkSkillList::insert_skill (unsigned int pos, GtkSkillInfo const& info)
 {
+  this->update_index(false);
+  this->count_requires(info, 1);
+  this->positions_valid = false;
+
+  this->dirty_from = std::min(this->dirty_from, pos);
   this->insert(this->begin() + pos, info);
+  this->calc_size += 1;
+  this->index_size += 1;
 }
 
 /* ---------------------------------------------------------------- */
@@ -122,7 +206,14 @@ GtkSkillList::insert_skill (unsigned int pos, GtkSkillInfo const& info)
 void
 GtkSkillList::delete_skill (unsigned int index)
 {
+  this->update_index(false);
+  this->count_requires(this->at(index), -1);
+  this->positions_valid = false;
+
+  this->dirty_from = std::min(this->dirty_from, index);
   this->erase(this->begin() + index);
+  this->calc_size -= 1;
+  this->index_size -= 1;
 }
 
 /* ---------------------------------------------------------------- */
@@ -166,19 +257,64 @@ GtkSkillList::calc_details (bool use_active_spph)
 
 /* ---------------------------------------------------------------- */
 
-void
-GtkSkillList::calc_details (ApiCharAttribs& attribs, bool use_active_spph)
+bool
+GtkSkillList::update_calc_state (ApiCharAttribs const& attribs,
+    bool use_active_spph)
 {
   ApiCharSheetPtr cs = this->character->cs;
 
   int train_skill = -1;
   int train_level = -1;
+  time_t train_end = 0;
   if (this->character->is_training())
   {
     train_skill = this->character->training_info.skill_id;
     train_level = this->character->training_info.to_level;
+    train_end = this->character->training_info.end_time_t;
   }
 
+  bool changed = this->size() != this->calc_size
+      || attribs.intl != this->calc_attribs.intl
+      || attribs.mem != this->calc_attribs.mem
+      || attribs.cha != this->calc_attribs.cha
+      || attribs.per != this->calc_attribs.per
+      || attribs.wil != this->calc_attribs.wil
+      || use_active_spph != this->calc_active_spph
+      || cs->total_sp != this->calc_char_sp
+      || cs->skills.size() != this->calc_char_skills
+      || train_skill != this->calc_train_skill
+      || train_level != this->calc_train_level
+      || train_end != this->calc_train_end
+      || this->character->training_spph != this->calc_train_spph;
+
+  this->calc_size = this->size();
+  this->calc_attribs = attribs;
+  this->calc_active_spph = use_active_spph;
+  this->calc_char_sp = cs->total_sp;
+  this->calc_char_skills = cs->skills.size();
+  this->calc_train_skill = train_skill;
+  this->calc_train_level = train_level;
+  this->calc_train_end = train_end;
+  this->calc_train_spph = this->character->training_spph;
+
+  return changed;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+GtkSkillList::calc_details (ApiCharAttribs& attribs, bool use_active_spph)
+{
+  ApiCharSheetPtr cs = this->character->cs;
+
+  /* Recalculate everything if the plan has been modified directly,
+   * or if other attributes or a changed character are used. */
+  if (this->update_calc_state(attribs, use_active_spph))
+    this->dirty_from = 0;
+
+  int train_skill = this->calc_train_skill;
+  int train_level = this->calc_train_level;
+
   /* Cached values for time calculations. */
   time_t now = EveTime::get_local_time();
   time_t now_eve = EveTime::get_eve_time();
@@ -187,18 +323,35 @@ GtkSkillList::calc_details (ApiCharAttribs& attribs, bool use_active_spph)
   /* Go through list and do mighty things. Caching the cskill variable
    * will greatly reduce relookup of the charsheet skill. */
   ApiCharSheetSkill* cskill = 0;
+  this->update_index(true);
   this->total_plan_sp = 0;
   for (unsigned int i = 0; i < this->size(); ++i)
   {
     GtkSkillInfo& info = this->at(i);
     ApiSkill const* skill = info.skill;
 
+    /* Cache if the current skill is in training. */
+    bool active = (skill->id == train_skill && info.plan_level == train_level);
+
+    /* Skills before the first modified one keep their details and are
+     * only moved in time. The skill in training depends on the time. */
+    if (i < this->dirty_from && !active)
+    {
+      info.start_time = now + duration;
+      info.finish_time = now + duration + info.skill_duration;
+      info.train_duration = duration + info.skill_duration;
+
+      duration += info.skill_duration;
+      this->total_plan_sp += info.dest_sp - info.start_sp;
+      continue;
+    }
+
     /* Only relookup the character skill if we really need to. */
     if (cskill == 0 || skill->id != cskill->id)
       cskill = cs->get_skill_for_id(skill->id);
 
     /* Update the skill icon. */
-    if (skill->id == train_skill && info.plan_level == train_level)
+    if (active)
       this->at(i).skill_icon = SKILL_STATUS_TRAINING;
     else if (this->has_char_skill(skill, info.plan_level))
       this->at(i).skill_icon = SKILL_STATUS_TRAINED;
@@ -209,9 +362,6 @@ GtkSkillList::calc_details (ApiCharAttribs& attribs, bool use_active_spph)
     else
       this->at(i).skill_icon = SKILL_STATUS_MISSING_DEPS;
 
-    /* Cache if the current skill is in training. */
-    bool active = (skill->id == train_skill && info.plan_level == train_level);
-
     /* SP per second and per hour. */
     unsigned int spph;
     if (active && use_active_spph)
@@ -253,6 +403,8 @@ GtkSkillList::calc_details (ApiCharAttribs& attribs, bool use_active_spph)
     duration += timediff;
     this->total_plan_sp += info.dest_sp - info.start_sp;
   }
+
+  this->dirty_from = (unsigned int)this->size();
 }
 
 /* ---------------------------------------------------------------- */
@@ -273,29 +425,29 @@ GtkSkillList::has_plan_dep_skills (unsigned int index)
   ApiSkill const* skill = this->at(index).skill;
   int plan_level = this->at(index).plan_level;
 
+  this->update_index(true);
+
   /* Check for previous level for level > 1. */
   if (plan_level > 1)
   {
-    for (int j = (int)index - 1; j >= 0; --j)
-      if (this->at(j).skill == skill
-          && this->at(j).plan_level == plan_level - 1)
-        return true;
-    return false;
+    int pos = this->plan_positions.find(this->get_plan_key
+        (skill->id, plan_level - 1));
+    return pos >= 0 && pos < (int)index;
   }
 
-  /* Check for skill deps in the list. */
-  for (int i = 0; i < (int)skill->deps.size(); ++i)
+  /* Check for skill deps in the list or known by the character. */
+  for (std::size_t i = 0; i < skill->deps.size(); ++i)
   {
+    int dep_id = skill->deps[i].first;
+    int dep_level = skill->deps[i].second;
+    if (this->character->cs->get_level_for_skill(dep_id) >= dep_level)
+      continue;
+
     bool has_this_dep = false;
-    for (int j = (int)index - 1; j >= 0 && !has_this_dep; --j)
+    for (int level = dep_level; level <= 5 && !has_this_dep; ++level)
     {
-      if (this->at(j).skill->id == skill->deps[i].first
-          && this->at(j).plan_level >= skill->deps[i].second)
-        has_this_dep = true;
-
-      if (this->character->cs->get_level_for_skill
-          (skill->deps[i].first) >= skill->deps[i].second)
-        has_this_dep = true;
+      int pos = this->plan_positions.find(this->get_plan_key(dep_id, level));
+      has_this_dep = (pos >= 0 && pos < (int)index);
     }
 
     if (!has_this_dep)
@@ -350,16 +502,15 @@ bool
 GtkSkillList::has_plan_skill (ApiSkill const* skill, int level,
     bool make_objective)
 {
-  for (unsigned int i = 0; i < this->size(); ++i)
-    if (this->at(i).skill == skill && this->at(i).plan_level == level)
-    {
-      if (make_objective)
-        this->at(i).is_objective = true;
+  this->update_index(true);
+  int pos = this->plan_positions.find(this->get_plan_key(skill->id, level));
+  if (pos < 0)
+    return false;
 
-      return true;
-    }
+  if (make_objective)
+    this->at(pos).is_objective = true;
 
-  return false;
+  return true;
 }
 
 /* ---------------------------------------------------------------- */
@@ -367,128 +518,71 @@ GtkSkillList::has_plan_skill (ApiSkill const* skill, int level,
 bool
 GtkSkillList::is_dependency (unsigned int index)
 {
-  for (unsigned int i = 0; i < this->size(); ++i)
-  {
-    if (i == index)
-      continue;
+  this->update_index(false);
+  GtkSkillInfo const& info = this->at(index);
+  return this->plan_requires.find(this->get_plan_key
+      (info.skill->id, info.plan_level)) > 0;
+}
 
-    if (this->at(i).skill == this->at(index).skill
-        && this->at(i).plan_level - 1 == this->at(index).plan_level)
-      return true;
+/* ---------------------------------------------------------------- */
 
-    for (unsigned int j = 0; j < this->at(i).skill->deps.size(); ++j)
-    {
-      if (this->at(i).skill->deps[j].first == this->at(index).skill->id
-          && this->at(i).skill->deps[j].second == this->at(index).plan_level)
-        return true;
-    }
-  }
+void
+GtkSkillList::setup_optimizer (AttribOptimizer& optimizer) const
+{
+  ApiCharSheetPtr charsheet = this->character->cs;
+  optimizer.set_attribs(charsheet->base, charsheet->implant,
+      charsheet->total);
 
-  return false;
+  for (unsigned int i = 0; i < this->size(); ++i)
+  {
+    GtkSkillInfo const& info = this->at(i);
+    optimizer.add_entry(info.skill, info.dest_sp - info.start_sp);
+  }
 }
 
 /* ---------------------------------------------------------------- */
 
 OptimalData
-GtkSkillList::get_optimal_data (void) const
+GtkSkillList::get_optimal_data (AttribOptResult const& best)
 {
-  GtkSkillList plan = *this;
-
-  /* Fetch the character from the plan. */
-  ApiCharSheetPtr charsheet = this->get_character()->cs;
-
-  /* Fetch base and implant attribute points. */
-  ApiCharAttribs base_atts = charsheet->base;
-  ApiCharAttribs implant_atts = charsheet->implant;
-  ApiCharAttribs total_atts = charsheet->total;
-
-    /* Use the current total time and base attributes as base. */
-  ApiCharAttribs cur_base_atts = base_atts;
-  ApiCharAttribs cur_total_atts = total_atts;
-  ApiCharAttribs best_base_atts = base_atts;
-  ApiCharAttribs best_total_atts = total_atts;
-
-    /* Calculate the maximum number of points that can be assigned to each
-   * attribute. */
-  int max_points_per_att = MAXIMUM_VALUE_PER_ATTRIB
-      - MINIMUM_VALUE_PER_ATTRIB;
-
-  /* Calculate the total number of base attribute points to distribute if it
-   * changes in the future. */
-  int total_base_atts = (int)cur_base_atts.cha + (int)cur_base_atts.intl
-      + (int)cur_base_atts.mem + (int)cur_base_atts.per
-      + (int)cur_base_atts.wil - (MINIMUM_VALUE_PER_ATTRIB * 5);
-
-  plan.calc_details(cur_total_atts, false);
-
-  time_t orig_total_time = plan.back().train_duration;
-  time_t cur_total_time = orig_total_time;
-  time_t best_total_time = orig_total_time;
-
-  /* Go through all combinations and compare the runtime.
-   * This algorithm has been found in EVEMon.
-   *
-   * This is O(scary), but seems quick enough in practice.
-   */
-  for (int intl = 0; intl <= max_points_per_att; intl++)
-  {
-    int max_mem = total_base_atts - intl;
-    for (int mem = 0; mem <= max_points_per_att && mem <= max_mem; mem++)
-    {
-      int max_cha = max_mem - mem;
-      for (int cha = 0; cha <= max_points_per_att && cha <= max_cha; cha++)
-      {
-        int max_per = max_cha - cha;
-        for (int per = 0; per <= max_points_per_att && per <= max_per; per++)
-        {
-          int wil = max_per - per;
-          if (wil <= max_points_per_att)
-          {
-            /* Calculate the base attributes based on the current
-             * values. */
-            cur_base_atts.intl = intl + MINIMUM_VALUE_PER_ATTRIB;
-            cur_base_atts.mem = mem + MINIMUM_VALUE_PER_ATTRIB;
-            cur_base_atts.cha = cha + MINIMUM_VALUE_PER_ATTRIB;
-            cur_base_atts.per = per + MINIMUM_VALUE_PER_ATTRIB;
-            cur_base_atts.wil = wil + MINIMUM_VALUE_PER_ATTRIB;
-
-            /* Calculate the total attributes based on the
-             * current base attributes and the fetched learning skills
-             * and implants. */
-            cur_total_atts = cur_base_atts + implant_atts;
-
-            ApiCharAttribs cur_total_atts_copy = cur_total_atts;
-            plan.calc_details(cur_total_atts_copy, false);
-            cur_total_time = plan.back().train_duration;
-
-            if (cur_total_time < best_total_time)
-            {
-              best_total_time = cur_total_time;
-              best_base_atts = cur_base_atts;
-              best_total_atts = cur_total_atts;
-            }
-          }
-        }
-      }
-    }
-  }
-
-  /* Calculate the details for the new list with the best attributes. */
-  {
-    ApiCharAttribs best_total_atts_copy = best_total_atts;
-    plan.calc_details(best_total_atts_copy, false);
-  }
   OptimalData result;
-  result.optimal_time = plan.back().train_duration;
-  result.spph = plan.get_spph();
-  result.intelligence = best_total_atts.intl;
-  result.memory = best_total_atts.mem;
-  result.perception = best_total_atts.per;
-  result.willpower = best_total_atts.wil;
-  result.charisma = best_total_atts.cha;
+  result.optimal_time = best.best_time;
+  result.spph = best.plan_sp * 3600.0 / (double)best.best_time;
+  result.intelligence = best.total.intl;
+  result.memory = best.total.mem;
+  result.perception = best.total.per;
+  result.willpower = best.total.wil;
+  result.charisma = best.total.cha;
   return result;
 }
 
+/* ---------------------------------------------------------------- */
+
+std::string
+GtkSkillList::get_optimizer_key (void) const
+{
+  ApiCharSheetPtr cs = this->character->cs;
+
+  /* The training time does not depend on the order of the plan. */
+  std::vector<int> plan_skills;
+  for (unsigned int i = 0; i < this->size(); ++i)
+    plan_skills.push_back(this->at(i).skill->id * 10
+        + this->at(i).plan_level);
+  std::sort(plan_skills.begin(), plan_skills.end());
+
+  int base_total = (int)cs->base.intl + (int)cs->base.mem
+      + (int)cs->base.cha + (int)cs->base.per + (int)cs->base.wil;
+
+  std::stringstream ss;
+  ss << cs->total_sp << " " << base_total << " " << cs->implant.intl
+      << " " << cs->implant.mem << " " << cs->implant.cha
+      << " " << cs->implant.per << " " << cs->implant.wil;
+  for (std::size_t i = 0; i < plan_skills.size(); ++i)
+    ss << " " << plan_skills[i];
+
+  return ss.str();
+}
+
 /* ================================================================ */
 
 GtkTreeModelColumns::GtkTreeModelColumns (void)
@@ -967,25 +1061,80 @@ GtkTrainingPlan::update_plan (bool rebuild)
   {
     this->total_time.set_text("Skill plan is empty.");
     this->optimal_time.set_text("Skill plan is empty.");
+    this->optimal_job.reset();
+    this->optimal_key.clear();
   }
   else
   {
-    OptimalData optimal_data = this->skills.get_optimal_data();
     this->total_time.set_text(EveTime::get_string_for_timediff
         (this->skills.back().train_duration, false)
         + "  (" + Helpers::get_string_from_sizet(this->skills.size())
         + " skills, " + Helpers::get_dotted_str_from_uint
           (this->skills.get_total_plan_sp()) + " SP, "
         + Helpers::get_string_from_double(this->skills.get_spph(),0) + " SP/h)");
-    this->optimal_time.set_text(EveTime::get_string_for_timediff
-          (optimal_data.optimal_time, false) + " ("
-          + Helpers::get_string_from_double(optimal_data.spph,0) + " SP/h, Int: "
-          + Helpers::get_string_from_double(optimal_data.intelligence,0) + ", Mem: "
-          + Helpers::get_string_from_double(optimal_data.memory,0) + ", Wil: "
-          + Helpers::get_string_from_double(optimal_data.willpower,0) + ", Per: "
-          + Helpers::get_string_from_double(optimal_data.perception,0) + ", Cha: "
-          + Helpers::get_string_from_double(optimal_data.charisma,0) + ")");
+    this->update_optimal_time();
+  }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+GtkTrainingPlan::update_optimal_time (void)
+{
+  /* Nothing to do if the result is shown or already being calculated. */
+  std::string key = this->skills.get_optimizer_key();
+  if (key == this->optimal_key)
+    return;
+
+  this->optimal_key = key;
+
+  std::map<std::string, OptimalData>::iterator iter
+      = this->optimal_cache.find(key);
+  if (iter != this->optimal_cache.end())
+  {
+    this->optimal_job.reset();
+    this->set_optimal_time(iter->second);
+    return;
   }
+
+  /* Replacing the job cancels the calculation for the outdated plan. */
+  this->optimal_job = AttribOptimizer::create();
+  this->skills.setup_optimizer(*this->optimal_job);
+  this->optimal_job->signal_done().connect(sigc::mem_fun
+      (*this, &GtkTrainingPlan::on_optimal_data_ready));
+  this->optimal_job->optimize_async();
+
+  this->optimal_time.set_text("Calculating...");
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+GtkTrainingPlan::on_optimal_data_ready (void)
+{
+  OptimalData optimal_data = GtkSkillList::get_optimal_data
+      (this->optimal_job->get_result());
+
+  if (this->optimal_cache.size() >= PLANNER_OPTIMAL_CACHE_SIZE)
+    this->optimal_cache.clear();
+  this->optimal_cache[this->optimal_key] = optimal_data;
+
+  this->set_optimal_time(optimal_data);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+GtkTrainingPlan::set_optimal_time (OptimalData const& optimal_data)
+{
+  this->optimal_time.set_text(EveTime::get_string_for_timediff
+        (optimal_data.optimal_time, false) + " ("
+        + Helpers::get_string_from_double(optimal_data.spph,0) + " SP/h, Int: "
+        + Helpers::get_string_from_double(optimal_data.intelligence,0) + ", Mem: "
+        + Helpers::get_string_from_double(optimal_data.memory,0) + ", Wil: "
+        + Helpers::get_string_from_double(optimal_data.willpower,0) + ", Per: "
+        + Helpers::get_string_from_double(optimal_data.perception,0) + ", Cha: "
+        + Helpers::get_string_from_double(optimal_data.charisma,0) + ")");
 }
 
 /* ---------------------------------------------------------------- */
@@ -1080,6 +1229,7 @@ GtkTrainingPlan::load_current_plan (void)
     this->skills.push_back(info);
   }
 
+  this->skills.invalidate();
   this->update_plan(true);
 }
 
@@ -11,16 +11,23 @@
 #ifndef GTK_TRAINING_PLAN
 #define GTK_TRAINING_PLAN
 
+#include <map>
+#include <string>
+#include <algorithm>
 #include <gtkmm.h>
 
 #include "bits/config.h"
 #include "bits/character.h"
+#include "bits/attriboptimizer.h"
+#include "util/idindex.h"
 #include "gtkportrait.h"
 #include "gtkcolumnsbase.h"
 #include "gtkconfwidgets.h"
 
 /* Update the time values for skills this milli seconds. */
 #define PLANNER_SKILL_TIME_UPDATE 10000
+/* Amount of optimal attribute results remembered by the planner. */
+#define PLANNER_OPTIMAL_CACHE_SIZE 16
 
 enum GtkSkillIcon
 {
@@ -70,8 +77,35 @@ class GtkSkillList : public std::vector<GtkSkillInfo>
     CharacterPtr character;
     unsigned int total_plan_sp;
 
+    /* Details are valid for all skills before "dirty_from" as long as
+     * the plan size and the state they were calculated for is kept. */
+    unsigned int dirty_from;
+    std::size_t calc_size;
+    ApiCharAttribs calc_attribs;
+    bool calc_active_spph;
+    unsigned int calc_char_sp;
+    std::size_t calc_char_skills;
+    int calc_train_skill;
+    int calc_train_level;
+    time_t calc_train_end;
+    unsigned int calc_train_spph;
+
+    /* Index from (skill, level) to the first plan position and to the
+     * amount of plan skills that directly require it. */
+    IdIndex plan_positions;
+    IdIndex plan_requires;
+    std::size_t index_size;
+    bool index_valid;
+    bool positions_valid;
+
   protected:
+    static int get_plan_key (int skill_id, int level);
+    void update_index (bool positions);
+    void count_requires (GtkSkillInfo const& info, int delta);
+
     void append_skill (ApiSkill const* skill, int level, bool objective);
+    bool update_calc_state (ApiCharAttribs const& attribs,
+        bool use_active_spph);
 
   public:
     GtkSkillList (void);
@@ -95,18 +129,32 @@ class GtkSkillList : public std::vector<GtkSkillInfo>
         bool make_objective = false);
     bool is_dependency (unsigned int index);
 
+    /* Marks the details of all skills from the given index on and the
+     * skill index as outdated. Required if the list is modified directly. */
+    void invalidate (unsigned int from = 0);
+
     /* Returns the total SP in the plan. */
     unsigned int get_total_plan_sp (void) const;
 
     /* Calculate all details for the skill plan. If attributes and
      * the learning level are specified, these are used instead
      * of the character ones. "use_active_spph" specifies if the SP/h
-     * for the skill in training is taken from the training sheet. */
+     * for the skill in training is taken from the training sheet.
+     * Only skills starting with the first modified one are fully
+     * recalculated, the others only get their times updated. */
     void calc_details (bool use_active_spph = true);
     void calc_details (ApiCharAttribs& attribs, bool use_active_spph = true);
     //void simulate_select (unsigned int index);
 
-    OptimalData get_optimal_data (void) const;
+    /* Sets up the optimizer with the character attributes and the SP
+     * left to train for every skill. Requires calculated details. */
+    void setup_optimizer (AttribOptimizer& optimizer) const;
+    static OptimalData get_optimal_data (AttribOptResult const& result);
+
+    /* Returns a key for what the optimal attributes depend on: The
+     * skills in the plan (regardless of order), the character SP,
+     * the base attribute total and the implant attributes. */
+    std::string get_optimizer_key (void) const;
 
     double get_spph(void) const;
 };
@@ -187,6 +235,11 @@ class GtkTrainingPlan : public Gtk::Box
     Gtk::Label total_time;
     Gtk::Label optimal_time;
 
+    /* Optimal attributes are calculated in the background and cached. */
+    std::map<std::string, OptimalData> optimal_cache;
+    std::string optimal_key;
+    AttribOptimizerPtr optimal_job;
+
     GtkTreeModelColumns cols;
     Glib::RefPtr<Gtk::ListStore> liststore;
     Gtk::TreeView treeview;
@@ -199,6 +252,9 @@ class GtkTrainingPlan : public Gtk::Box
 
   protected:
     void update_plan (bool rebuild);
+    void update_optimal_time (void);
+    void set_optimal_time (OptimalData const& data);
+    void on_optimal_data_ready (void);
 
     void init_from_config (void);
     void store_to_config (void);
@@ -245,6 +301,20 @@ inline void
 GtkSkillList::set_character (CharacterPtr character)
 {
   this->character = character;
+  this->invalidate();
+}
+
+inline void
+GtkSkillList::invalidate (unsigned int from)
+{
+  this->dirty_from = std::min(this->dirty_from, from);
+  this->index_valid = false;
+}
+
+inline int
+GtkSkillList::get_plan_key (int skill_id, int level)
+{
+  return skill_id * 8 + level;
 }
 
 inline CharacterPtr
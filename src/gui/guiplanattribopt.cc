@@ -341,97 +341,44 @@ void
 GuiPlanAttribOpt::optimize_plan (void)
 {
   /* Copy the original plan because it may be altered later. */
-  GtkSkillList plan_part = this->plan;
+  this->plan_orig = this->plan;
+  if (this->plan_offset > 0)
+    this->plan_orig.erase(this->plan_orig.begin(),
+        this->plan_orig.begin() + this->plan_offset);
 
-  /* Fetch the character from the plan. */
+  /* Calculate the original plan with the original attribues. */
   ApiCharSheetPtr charsheet = this->plan.get_character()->cs;
-
-  /* Fetch base and implant attribute points. */
-  ApiCharAttribs base_atts = charsheet->base;
-  ApiCharAttribs implant_atts = charsheet->implant;
   ApiCharAttribs total_atts = charsheet->total;
+  this->plan_orig.calc_details(total_atts, false);
+
+  /* Search the best attributes in the background. Replacing the
+   * optimizer cancels a search that is still in progress. */
+  this->optimizer = AttribOptimizer::create();
+  this->plan_orig.setup_optimizer(*this->optimizer);
+  this->optimizer->signal_done().connect(sigc::mem_fun
+      (*this, &GuiPlanAttribOpt::on_optimizer_done));
+  this->optimizer->optimize_async();
+
+  this->original_time_label.set_text(EveTime::get_string_for_timediff
+      (this->plan_orig.back().train_duration, false));
+  this->best_time_label.set_text("Calculating...");
+  this->difference_time_label.set_text("Calculating...");
+  this->liststore->clear();
+}
 
-  if (this->plan_offset > 0)
-    plan_part.erase(plan_part.begin(), plan_part.begin() + this->plan_offset);
-
-  /* Copy the possibly cleaned plan to have an original one for comparison. */
-  GtkSkillList plan_orig = plan_part;
-
-  /* Use the current total time and base attributes as base. */
-  ApiCharAttribs cur_base_atts = base_atts;
-  ApiCharAttribs cur_total_atts = total_atts;
-  ApiCharAttribs best_base_atts = base_atts;
-  ApiCharAttribs best_total_atts = total_atts;
+/* ---------------------------------------------------------------- */
 
-  /* Calculate the original plan with the original attribues. */
-  plan_orig.calc_details(cur_total_atts, false);
-  cur_total_atts = total_atts;
-
-  time_t orig_total_time = plan_orig.back().train_duration;
-  time_t cur_total_time = orig_total_time;
-  time_t best_total_time = orig_total_time;
-
-  /* Calculate the maximum number of points that can be assigned to each
-   * attribute. */
-  int max_points_per_att = MAXIMUM_VALUE_PER_ATTRIB
-      - MINIMUM_VALUE_PER_ATTRIB;
-
-  /* Calculate the total number of base attribute points to distribute if it
-   * changes in the future. */
-  int total_base_atts = (int)cur_base_atts.cha + (int)cur_base_atts.intl
-      + (int)cur_base_atts.mem + (int)cur_base_atts.per
-      + (int)cur_base_atts.wil - (MINIMUM_VALUE_PER_ATTRIB * 5);
-
-
-  /* Go through all combinations and compare the runtime.
-   * This algorithm has been found in EVEMon.
-   *
-   * This is O(scary), but seems quick enough in practice.
-   */
-  for (int intl = 0; intl <= max_points_per_att; intl++)
-  {
-    int max_mem = total_base_atts - intl;
-    for (int mem = 0; mem <= max_points_per_att && mem <= max_mem; mem++)
-    {
-      int max_cha = max_mem - mem;
-      for (int cha = 0; cha <= max_points_per_att && cha <= max_cha; cha++)
-      {
-        int max_per = max_cha - cha;
-        for (int per = 0; per <= max_points_per_att && per <= max_per; per++)
-        {
-          int wil = max_per - per;
-          if (wil <= max_points_per_att)
-          {
-            /* Calculate the base attributes based on the current
-             * values. */
-            cur_base_atts.intl = intl + MINIMUM_VALUE_PER_ATTRIB;
-            cur_base_atts.mem = mem + MINIMUM_VALUE_PER_ATTRIB;
-            cur_base_atts.cha = cha + MINIMUM_VALUE_PER_ATTRIB;
-            cur_base_atts.per = per + MINIMUM_VALUE_PER_ATTRIB;
-            cur_base_atts.wil = wil + MINIMUM_VALUE_PER_ATTRIB;
-
-            /* Calculate the total attributes based on the
-             * current base attributes and the fetched learning skills
-             * and implants. */
-            cur_total_atts = cur_base_atts + implant_atts;
-
-            ApiCharAttribs cur_total_atts_copy = cur_total_atts;
-            plan_part.calc_details(cur_total_atts_copy, false);
-            cur_total_time = plan_part.back().train_duration;
-
-            if (cur_total_time < best_total_time)
-            {
-              best_total_time = cur_total_time;
-              best_base_atts = cur_base_atts;
-              best_total_atts = cur_total_atts;
-            }
-          }
-        }
-      }
-    }
-  }
+void
+GuiPlanAttribOpt::on_optimizer_done (void)
+{
+  AttribOptResult const& result = this->optimizer->get_result();
+  ApiCharAttribs best_base_atts = result.base;
+  ApiCharAttribs best_total_atts = result.total;
+  time_t orig_total_time = result.orig_time;
+  time_t best_total_time = result.best_time;
 
   /* Calculate the details for the new list with the best attributes. */
+  GtkSkillList plan_part = this->plan_orig;
   {
     ApiCharAttribs best_total_atts_copy = best_total_atts;
     plan_part.calc_details(best_total_atts_copy, false);
@@ -494,7 +441,8 @@ GuiPlanAttribOpt::optimize_plan (void)
 
     /* Calculate the duration difference between the
      * old attributes and the optimized ones. */
-    time_t difference = info.skill_duration - plan_orig[i].skill_duration;
+    time_t difference = info.skill_duration
+        - this->plan_orig[i].skill_duration;
     if (difference < 0)
     {
       (*iter)[this->cols.difference]
@@ -13,14 +13,10 @@
 
 #include <gtkmm.h>
 
+#include "bits/attriboptimizer.h"
 #include "winbase.h"
 #include "gtktrainingplan.h"
 
-/* The minimum number of points that have to be assigned to each attribute. */
-#define MINIMUM_VALUE_PER_ATTRIB 17
-/* The maximum number of points that can be assigned to each attribute. */
-#define MAXIMUM_VALUE_PER_ATTRIB 27
-
 class GtkTreeModelColumnsOptimizer : public GtkTreeModelColumns
 {
   public:
@@ -46,7 +42,9 @@ class GuiPlanAttribOpt : public WinBase
 {
   private:
     GtkSkillList plan;
+    GtkSkillList plan_orig;
     std::size_t plan_offset;
+    AttribOptimizerPtr optimizer;
 
     Gtk::Notebook notebook;
     Gtk::RadioButton rb_whole_plan;
@@ -83,6 +81,7 @@ class GuiPlanAttribOpt : public WinBase
     void on_calculate_clicked (void);
     void set_selection_sensitivity (bool sensitive);
     void optimize_plan (void);
+    void on_optimizer_done (void);
 
   public:
     GuiPlanAttribOpt (void);
@@ -11,11 +11,11 @@
 #include <cerrno>
 #include <cstring>
 #include <iostream>
-#include <fstream>
 
 #include <gtkmm.h>
 
 #include "api/evetime.h"
+#include "util/exception.h"
 #include "util/helpers.h"
 #include "util/os.h"
 #include "bits/config.h"
@@ -289,30 +289,43 @@ GuiUpdater::on_download_done (DownloadItem dl, AsyncHttpData data)
     return;
   }
 
-  /* Check if file changed. */
+  /* Check if file changed. Validators for conditional requests are
+   * only remembered once the local file matches the download. */
   if (Updater::is_same_file(file.local_path, data.data))
+  {
+    Updater::set_validators(file, data.data);
     return;
+  }
 
-  /* Write file to disk. */
-  std::ofstream out(file.local_path.c_str());
-  if (!out)
+  /* Write file to a temporary file and replace the data file, so that
+   * a tree loaded at the same time never sees it partially written. */
+  std::string tmp_path = file.local_path + ".tmp";
+  try
+  {
+    Helpers::write_file(tmp_path, &data.data->data[0],
+        data.data->data.size());
+    if (!OS::rename_file(tmp_path.c_str(), file.local_path.c_str()))
+      throw FileException(file.local_path, ::strerror(errno));
+  }
+  catch (Exception& e)
   {
-    std::cout << "Error: Cannot write data file to disk." << std::endl;
+    OS::unlink(tmp_path.c_str());
+    Updater::clear_validators(file);
+    std::cout << "Error: Cannot write data file to disk: "
+        << e << std::endl;
 
     Gtk::MessageDialog md("Write to disk failed!",
         false, Gtk::MESSAGE_ERROR, Gtk::BUTTONS_OK);
     md.set_secondary_text("The download for " + dl.name
-        + " succeeded, but the file cannot be written to disk.\n\n"
-        + std::string(::strerror(errno)));
+        + " succeeded, but the file cannot be written to disk.\n\n" + e);
     md.set_transient_for(*this);
     md.run();
 
     this->download_error = true;
     return;
   }
-  out.write(&data.data->data[0], data.data->data.size());
-  out.close();
 
+  Updater::set_validators(file, data.data);
   this->is_updated = true;
   this->rebuild_files_box();
 }
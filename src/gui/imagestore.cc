@@ -49,6 +49,9 @@ Glib::RefPtr<Gdk::Pixbuf> ImageStore::skillplan[5];
 Glib::RefPtr<Gdk::Pixbuf> ImageStore::certgrades[4];
 Glib::RefPtr<Gdk::Pixbuf> ImageStore::certstatus[4];
 Glib::RefPtr<Gdk::Pixbuf> ImageStore::menuicons[3];
+Glib::RefPtr<Gdk::Pixbuf> ImageStore::skill_progress_base;
+Glib::RefPtr<Gdk::Pixbuf> ImageStore::skill_progress_icons[6]
+    [IMAGESTORE_PROGRESS_STEPS + 1];
 
 /* ---------------------------------------------------------------- */
 
@@ -154,24 +157,34 @@ ImageStore::init (void)
 Glib::RefPtr<Gdk::Pixbuf>
 ImageStore::skill_progress (unsigned int level, double completed)
 {
-  Glib::RefPtr<Gdk::Pixbuf> ret(Gdk::Pixbuf::create_from_xpm_data
-      (img_skillprogress_xpm));
-
   /* Some safety checks. */
   if (level > 5) level = 5;
   if (completed < 0.0) completed = 0.0;
   if (completed > 1.0) completed = 1.0;
 
+  unsigned int steps = (unsigned int)::round
+      (IMAGESTORE_PROGRESS_STEPS * completed);
+  Glib::RefPtr<Gdk::Pixbuf>& icon
+      = ImageStore::skill_progress_icons[level][steps];
+  if (icon)
+    return icon;
+
+  /* Render the icon once. The XPM is only decoded for the first one. */
+  if (!ImageStore::skill_progress_base)
+    ImageStore::skill_progress_base = Gdk::Pixbuf::create_from_xpm_data
+        (img_skillprogress_xpm);
+  icon = ImageStore::skill_progress_base->copy();
+
   /* draw level */
   for (unsigned int l = 0; l < level; ++l)
     for (unsigned int x = 0; x < 6; ++x)
-      ret->copy_area(0, 0, 1, 5, ret, (l * 7 + x + 2), 2);
+      icon->copy_area(0, 0, 1, 5, icon, (l * 7 + x + 2), 2);
 
   /* draw percent */
-  for (unsigned int p = 0; p < (unsigned int)::round(34.0 * completed); ++p)
-    ret->copy_area(0, 0, 1, 2, ret, (p + 2), 13);
+  for (unsigned int p = 0; p < steps; ++p)
+    icon->copy_area(0, 0, 1, 2, icon, (p + 2), 13);
 
-  return ret;
+  return icon;
 }
 
 /* ---------------------------------------------------------------- */
@@ -179,6 +192,10 @@ ImageStore::skill_progress (unsigned int level, double completed)
 void
 ImageStore::unload (void)
 {
+  for (unsigned int i = 0; i < 6; ++i)
+    for (unsigned int j = 0; j <= IMAGESTORE_PROGRESS_STEPS; ++j)
+      ImageStore::skill_progress_icons[i][j].reset();
+  ImageStore::skill_progress_base.reset();
 }
 
 /* ---------------------------------------------------------------- */
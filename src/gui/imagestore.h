@@ -13,9 +13,17 @@
 
 #include <gdkmm.h>
 
+/* Amount of pixels of the progress bar in the skill progress icon. */
+#define IMAGESTORE_PROGRESS_STEPS 34
+
 class ImageStore
 {
   private:
+    /* Skill progress icons by level and progress bar length. */
+    static Glib::RefPtr<Gdk::Pixbuf> skill_progress_base;
+    static Glib::RefPtr<Gdk::Pixbuf> skill_progress_icons[6]
+        [IMAGESTORE_PROGRESS_STEPS + 1];
+
     static Glib::RefPtr<Gdk::Pixbuf> create_from_inline (guint8 const* data);
 
   public:
@@ -35,6 +43,8 @@ class ImageStore
     static Glib::RefPtr<Gdk::Pixbuf> certstatus[4];
     static Glib::RefPtr<Gdk::Pixbuf> menuicons[3];
 
+    /* Returns the icon for the level and the completion of the next
+     * level. Icons are shared, don't modify them. */
     static Glib::RefPtr<Gdk::Pixbuf> skill_progress
         (unsigned int level, double percent);
 
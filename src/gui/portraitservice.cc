@@ -0,0 +1,316 @@
+// This file is part of GtkEveMon.
+//
+// GtkEveMon is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// You should have received a copy of the GNU General Public License
+// along with GtkEveMon. If not, see <http://www.gnu.org/licenses/>.
+
+#include <sstream>
+#include <iostream>
+
+#include "util/os.h"
+#include "bits/config.h"
+#include "bits/threadpool.h"
+#include "imagestore.h"
+#include "portraitservice.h"
+
+/*
+ * A portrait request for one character and size. The task first reads
+ * the portrait from the disc cache. If that fails, the service downloads
+ * the portrait and submits the task again to decode and scale the
+ * downloaded image and to store it in the disc cache.
+ */
+class PortraitJob : public ThreadPoolTask
+{
+  protected:
+    void run (void);
+
+    void load_from_file (void);
+    void load_from_data (void);
+
+  public:
+    std::string key;
+    std::string char_id;
+    int size;
+    bool downloaded;
+    HttpDataPtr data;
+    Glib::RefPtr<Gdk::Pixbuf> portrait;
+    sigc::signal<void> sig_ready;
+
+  public:
+    PortraitJob (void);
+};
+
+/* ---------------------------------------------------------------- */
+
+PortraitJob::PortraitJob (void)
+  : size(0), downloaded(false)
+{
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+PortraitJob::run (void)
+{
+  if (this->downloaded)
+    this->load_from_data();
+  else
+    this->load_from_file();
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+PortraitJob::load_from_file (void)
+{
+  std::string filename = PortraitService::get_portrait_file
+      (this->char_id, this->size);
+  if (!OS::file_exists(filename.c_str()))
+    return;
+
+  try
+  {
+    #ifdef GLIBMM_EXCEPTIONS_ENABLED
+    this->portrait = Gdk::Pixbuf::create_from_file(filename);
+    #else
+    std::auto_ptr<Glib::Error> error;
+    this->portrait = Gdk::Pixbuf::create_from_file(filename, error);
+    if (error.get())
+      throw error;
+    #endif
+  }
+  catch (...)
+  {
+    this->portrait.reset();
+  }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+PortraitJob::load_from_data (void)
+{
+  if (this->data->data.empty())
+    return;
+
+  /* HTTP documents carry a terminating zero. */
+  guint8 const* buffer = (guint8 const*)&this->data->data[0];
+  gsize size = (gsize)(this->data->data.size() - 1);
+
+  try
+  {
+    Glib::RefPtr<Gdk::PixbufLoader> loader = Gdk::PixbufLoader::create();
+    #ifdef GLIBMM_EXCEPTIONS_ENABLED
+    loader->write(buffer, size);
+    loader->close();
+    #else
+    std::auto_ptr<Glib::Error> error;
+    loader->write(buffer, size, error);
+    if (!error.get())
+      loader->close(error);
+    if (error.get())
+      throw error;
+    #endif
+
+    this->portrait = loader->get_pixbuf()->scale_simple
+        (this->size, this->size, Gdk::INTERP_BILINEAR);
+  }
+  catch (...)
+  {
+    this->portrait.reset();
+    std::cout << "Error decoding portrait for " << this->char_id << std::endl;
+    return;
+  }
+
+  /* Create portrait directory if it does not exist. */
+  std::string portraitdir = Config::get_conf_dir() + "/portraits";
+  if (!OS::dir_exists(portraitdir.c_str()))
+  {
+    /* Ignore errors. We'll get them on creation. */
+    OS::mkdir(portraitdir.c_str());
+  }
+
+  try
+  {
+    std::string filename = PortraitService::get_portrait_file
+        (this->char_id, this->size);
+    #ifdef GLIBMM_EXCEPTIONS_ENABLED
+    this->portrait->save(filename, "png");
+    #else
+    std::auto_ptr<Glib::Error> error;
+    this->portrait->save(filename, "png", error);
+    if (error.get())
+      throw error;
+    #endif
+  }
+  catch (...)
+  {
+    std::cout << "Error caching portrait for " << this->char_id << std::endl;
+    return;
+  }
+
+  std::cout << "Cached portrait: " << this->char_id << std::endl;
+}
+
+/* ================================================================ */
+
+PortraitService::PortraitMap PortraitService::portraits;
+PortraitService::JobMap PortraitService::jobs;
+
+/* ---------------------------------------------------------------- */
+
+void
+PortraitService::unload (void)
+{
+  PortraitService::jobs.clear();
+  PortraitService::portraits.clear();
+}
+
+/* ---------------------------------------------------------------- */
+
+Glib::RefPtr<Gdk::Pixbuf>
+PortraitService::get (std::string const& char_id, int size)
+{
+  PortraitMap::iterator iter = PortraitService::portraits.find
+      (PortraitService::get_key(char_id, size));
+  if (iter == PortraitService::portraits.end())
+    return Glib::RefPtr<Gdk::Pixbuf>();
+  return iter->second;
+}
+
+/* ---------------------------------------------------------------- */
+
+Glib::RefPtr<Gdk::Pixbuf>
+PortraitService::get_default (int size)
+{
+  std::string key = PortraitService::get_key("", size);
+  Glib::RefPtr<Gdk::Pixbuf>& portrait = PortraitService::portraits[key];
+  if (!portrait)
+    portrait = ImageStore::eveportrait->scale_simple
+        (size, size, Gdk::INTERP_BILINEAR);
+  return portrait;
+}
+
+/* ---------------------------------------------------------------- */
+
+sigc::connection
+PortraitService::request (std::string const& char_id, int size,
+    sigc::slot<void> const& slot, bool reload)
+{
+  /* Attach to a running request for the same portrait. */
+  std::string key = PortraitService::get_key(char_id, size);
+  JobMap::iterator iter = PortraitService::jobs.find(key);
+  if (iter != PortraitService::jobs.end())
+    return iter->second->sig_ready.connect(slot);
+
+  PortraitJobPtr job = make_ref<PortraitJob>();
+  job->key = key;
+  job->char_id = char_id;
+  job->size = size;
+  job->signal_done().connect(sigc::bind(sigc::ptr_fun
+      (&PortraitService::on_job_finished), key));
+  sigc::connection conn = job->sig_ready.connect(slot);
+  PortraitService::jobs.insert(std::make_pair(key, job));
+
+  if (reload)
+    PortraitService::start_download(job);
+  else
+    ThreadPool::submit(job);
+
+  return conn;
+}
+
+/* ---------------------------------------------------------------- */
+
+std::string
+PortraitService::get_portrait_file (std::string const& char_id, int size)
+{
+  std::stringstream filename;
+  filename << Config::get_conf_dir() << "/portraits";
+  filename << "/" << char_id << "_" << size << ".png";
+  return filename.str();
+}
+
+/* ---------------------------------------------------------------- */
+
+std::string
+PortraitService::get_key (std::string const& char_id, int size)
+{
+  std::stringstream key;
+  key << char_id << "_" << size;
+  return key.str();
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+PortraitService::on_job_finished (std::string key)
+{
+  JobMap::iterator iter = PortraitService::jobs.find(key);
+  if (iter == PortraitService::jobs.end())
+    return;
+
+  PortraitJobPtr job = iter->second;
+  if (!job->portrait && !job->downloaded)
+    PortraitService::start_download(job);
+  else
+    PortraitService::complete_job(job);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+PortraitService::start_download (PortraitJobPtr job)
+{
+  std::cout << "Requesting portrait: " << job->char_id
+      << " ..." << std::endl;
+
+  AsyncHttp* http = AsyncHttp::create();
+  http->set_host("image.eveonline.com");
+  http->set_path("/Character/" + job->char_id + "_256.jpg");
+  Config::setup_http(http, true);
+  http->signal_done().connect(sigc::bind(sigc::ptr_fun
+      (&PortraitService::on_download_done), job));
+  http->async_request();
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+PortraitService::on_download_done (AsyncHttpData result, PortraitJobPtr job)
+{
+  if (result.data.get() == 0)
+  {
+    std::cout << "Error fetching portrait from EVE Online!" << std::endl;
+    PortraitService::complete_job(job);
+    return;
+  }
+
+  if (result.data->http_code != 200)
+  {
+    std::cout << "Error fetching portrait: " << result.exception << std::endl;
+    PortraitService::complete_job(job);
+    return;
+  }
+
+  /* Decode and scale in the thread pool. */
+  job->data = result.data;
+  job->downloaded = true;
+  ThreadPool::submit(job);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+PortraitService::complete_job (PortraitJobPtr job)
+{
+  PortraitService::jobs.erase(job->key);
+  if (job->portrait)
+    PortraitService::portraits[job->key] = job->portrait;
+
+  job->sig_ready.emit();
+}
@@ -0,0 +1,68 @@
+// This file is part of GtkEveMon.
+//
+// GtkEveMon is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// You should have received a copy of the GNU General Public License
+// along with GtkEveMon. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef PORTRAIT_SERVICE_HEADER
+#define PORTRAIT_SERVICE_HEADER
+
+#include <map>
+#include <string>
+
+#include <gdkmm.h>
+
+#include "util/ref_ptr.h"
+#include "net/asynchttp.h"
+
+class PortraitJob;
+typedef ref_ptr<PortraitJob> PortraitJobPtr;
+
+/*
+ * Provides character portraits in any size. Decoded portraits are kept
+ * in memory per character and size and shared by all portrait widgets.
+ * Missing portraits are read from the disc cache or downloaded from the
+ * EVE image server. Decoding and scaling runs in the thread pool, the
+ * result is delivered in the main thread. Requests for a portrait that
+ * is already being loaded are attached to the running request.
+ */
+class PortraitService
+{
+  friend class PortraitJob;
+
+  private:
+    typedef std::map<std::string, Glib::RefPtr<Gdk::Pixbuf> > PortraitMap;
+    typedef std::map<std::string, PortraitJobPtr> JobMap;
+
+    static PortraitMap portraits;
+    static JobMap jobs;
+
+    static std::string get_key (std::string const& char_id, int size);
+    static std::string get_portrait_file (std::string const& char_id,
+        int size);
+    static void on_job_finished (std::string key);
+    static void on_download_done (AsyncHttpData result, PortraitJobPtr job);
+    static void start_download (PortraitJobPtr job);
+    static void complete_job (PortraitJobPtr job);
+
+  public:
+    static void unload (void);
+
+    /* Returns the portrait from memory or an empty pointer. */
+    static Glib::RefPtr<Gdk::Pixbuf> get (std::string const& char_id,
+        int size);
+    /* Returns the fallback portrait in the given size. */
+    static Glib::RefPtr<Gdk::Pixbuf> get_default (int size);
+
+    /* Loads the portrait and calls the slot in the main thread once it
+     * is available via get(). If reload is set, the portrait is
+     * downloaded again even if it is cached on disc. */
+    static sigc::connection request (std::string const& char_id, int size,
+        sigc::slot<void> const& slot, bool reload = false);
+};
+
+#endif /* PORTRAIT_SERVICE_HEADER */
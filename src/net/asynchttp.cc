@@ -11,12 +11,28 @@ AsyncHttp::AsyncHttp (void)
 
 /* ---------------------------------------------------------------- */
 
-void*
-AsyncHttp::run (void)
+CURL*
+AsyncHttp::start_transfer (void)
 {
   try
   {
-    HttpDataPtr data = this->request();
+    return this->start_request();
+  }
+  catch (Exception& e)
+  {
+    this->abort_transfer(e);
+    return 0;
+  }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+AsyncHttp::finish_transfer (CURL* handle, CURLcode res)
+{
+  try
+  {
+    HttpDataPtr data = this->finish_request(handle, res);
     this->http_result.data = data;
 
     /* If we receive a HTTP status code other than 200,
@@ -35,12 +51,17 @@ AsyncHttp::run (void)
     this->http_result.data.reset();
   }
 
-  /* Simulate some lag. */
-  //::srand(::time(0));
-  //::sleep(::rand() % 3 + 1);
+  this->sig_dispatch.emit();
+}
+
+/* ---------------------------------------------------------------- */
 
+void
+AsyncHttp::abort_transfer (std::string const& error)
+{
+  this->http_result.exception = error;
+  this->http_result.data.reset();
   this->sig_dispatch.emit();
-  return 0;
 }
 
 /* ---------------------------------------------------------------- */
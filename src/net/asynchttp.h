@@ -15,9 +15,9 @@
 
 #include <glibmm/dispatcher.h>
 
-#include "util/thread.h"
 #include "util/exception.h"
 #include "http.h"
+#include "httpengine.h"
 
 /* This is delivered when the request ist done.
  * The data member is NULL if there was an error.
@@ -37,9 +37,12 @@ class AsyncHttpData
  * - Run async_request()
  * - Data will be delivered to all signal subscribers
  * - No need to free, automatic deletion if all signals are processed
+ * The transfer is run by the HttpEngine, no thread is created.
  */
-class AsyncHttp : public Thread, public Http
+class AsyncHttp : public Http
 {
+  friend class HttpEngine;
+
   private:
     AsyncHttpData http_result;
     Glib::Dispatcher sig_dispatch;
@@ -48,7 +51,10 @@ class AsyncHttp : public Thread, public Http
   protected:
     AsyncHttp (void);
 
-    void* run (void);
+    /* Called by the engine from the I/O thread. */
+    CURL* start_transfer (void);
+    void finish_transfer (CURL* handle, CURLcode res);
+    void abort_transfer (std::string const& error);
     void dispatch (void);
 
   public:
@@ -70,7 +76,7 @@ AsyncHttp::create (void)
 inline void
 AsyncHttp::async_request (void)
 {
-  this->pt_create();
+  HttpEngine::submit(this);
 }
 
 inline void
@@ -0,0 +1,142 @@
+#include <iostream>
+
+#include "curlpool.h"
+
+CURLSH* CurlPool::share = 0;
+std::vector<CURL*> CurlPool::idle;
+Semaphore CurlPool::pool_lock;
+Semaphore CurlPool::share_locks[CURL_LOCK_DATA_LAST];
+bool CurlPool::initialized = false;
+
+/* ---------------------------------------------------------------- */
+
+void
+CurlPool::init (void)
+{
+  CurlPool::pool_lock.wait();
+  CurlPool::init_intern();
+  CurlPool::pool_lock.post();
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+CurlPool::init_intern (void)
+{
+  if (CurlPool::initialized)
+    return;
+
+  curl_global_init(CURL_GLOBAL_ALL);
+
+  CurlPool::share = curl_share_init();
+  if (CurlPool::share != 0)
+  {
+    curl_share_setopt(CurlPool::share, CURLSHOPT_LOCKFUNC,
+        CurlPool::lock_share);
+    curl_share_setopt(CurlPool::share, CURLSHOPT_UNLOCKFUNC,
+        CurlPool::unlock_share);
+    curl_share_setopt(CurlPool::share, CURLSHOPT_SHARE,
+        CURL_LOCK_DATA_DNS);
+    curl_share_setopt(CurlPool::share, CURLSHOPT_SHARE,
+        CURL_LOCK_DATA_SSL_SESSION);
+#if LIBCURL_VERSION_NUM >= 0x073900
+    /* Sharing the connection cache requires libcurl 7.57.0. */
+    curl_share_setopt(CurlPool::share, CURLSHOPT_SHARE,
+        CURL_LOCK_DATA_CONNECT);
+#endif
+  }
+  else
+    std::cout << "Warning: Could not create curl share object" << std::endl;
+
+  CurlPool::initialized = true;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+CurlPool::unload (void)
+{
+  CurlPool::pool_lock.wait();
+  for (std::size_t i = 0; i < CurlPool::idle.size(); ++i)
+    curl_easy_cleanup(CurlPool::idle[i]);
+  CurlPool::idle.clear();
+
+  if (CurlPool::share != 0)
+    curl_share_cleanup(CurlPool::share);
+  CurlPool::share = 0;
+
+  if (CurlPool::initialized)
+    curl_global_cleanup();
+  CurlPool::initialized = false;
+  CurlPool::pool_lock.post();
+}
+
+/* ---------------------------------------------------------------- */
+
+CURL*
+CurlPool::acquire (void)
+{
+  CURL* handle = 0;
+
+  CurlPool::pool_lock.wait();
+  CurlPool::init_intern();
+  if (!CurlPool::idle.empty())
+  {
+    handle = CurlPool::idle.back();
+    CurlPool::idle.pop_back();
+  }
+  CurlPool::pool_lock.post();
+
+  if (handle == 0)
+    handle = curl_easy_init();
+  if (handle == 0)
+    return 0;
+
+  if (CurlPool::share != 0)
+    curl_easy_setopt(handle, CURLOPT_SHARE, CurlPool::share);
+  curl_easy_setopt(handle, CURLOPT_TCP_KEEPALIVE, 1L);
+
+  return handle;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+CurlPool::release (CURL* handle)
+{
+  if (handle == 0)
+    return;
+
+  /* Resetting keeps the caches of the handle but drops all options. */
+  curl_easy_reset(handle);
+
+  CurlPool::pool_lock.wait();
+  if (CurlPool::initialized
+      && CurlPool::idle.size() < CURL_POOL_MAX_IDLE)
+  {
+    CurlPool::idle.push_back(handle);
+    handle = 0;
+  }
+  CurlPool::pool_lock.post();
+
+  if (handle != 0)
+    curl_easy_cleanup(handle);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+CurlPool::lock_share (CURL* /*handle*/, curl_lock_data data,
+    curl_lock_access /*access*/, void* /*user*/)
+{
+  CurlPool::share_locks[data].wait();
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+CurlPool::unlock_share (CURL* /*handle*/, curl_lock_data data,
+    void* /*user*/)
+{
+  CurlPool::share_locks[data].post();
+}
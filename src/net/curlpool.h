@@ -0,0 +1,58 @@
+/*
+ * This file is part of GtkEveMon.
+ *
+ * GtkEveMon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GtkEveMon. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CURL_POOL_HEADER
+#define CURL_POOL_HEADER
+
+#include <vector>
+#include <curl/curl.h>
+
+#include "util/thread.h"
+
+/* Amount of idle curl handles kept for reuse. */
+#define CURL_POOL_MAX_IDLE 8
+
+/*
+ * Process-wide pool of curl handles. All handles share DNS cache,
+ * TLS sessions and (if supported by libcurl) open connections, so that
+ * repeated requests to the same host reuse warm connections instead of
+ * doing the DNS lookup and the TCP and TLS handshakes again.
+ * Handles are borrowed with acquire() and must be returned with release().
+ */
+class CurlPool
+{
+  private:
+    static CURLSH* share;
+    static std::vector<CURL*> idle;
+    static Semaphore pool_lock;
+    static Semaphore share_locks[CURL_LOCK_DATA_LAST];
+    static bool initialized;
+
+    static void init_intern (void);
+    static void lock_share (CURL* handle, curl_lock_data data,
+        curl_lock_access access, void* user);
+    static void unlock_share (CURL* handle, curl_lock_data data, void* user);
+
+  public:
+    /* Sets up libcurl. Call this before any other thread is running. */
+    static void init (void);
+    /* Frees all idle handles and the share object. */
+    static void unload (void);
+
+    /* Returns a handle with default options and the share attached.
+     * Returns NULL if libcurl fails to create a handle. */
+    static CURL* acquire (void);
+    /* Resets the handle and keeps it for later requests. */
+    static void release (CURL* handle);
+};
+
+#endif /* CURL_POOL_HEADER */
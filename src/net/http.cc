@@ -3,10 +3,114 @@
 #include <sstream>
 #include <string>
 #include <cstdlib>
+#include <cctype>
+#include <algorithm>
+#include <new>
 
 #include "util/exception.h"
+#include "curlpool.h"
 #include "http.h"
 
+std::vector<std::vector<char> >&
+HttpData::get_buffer_pool (void)
+{
+  static std::vector<std::vector<char> >* pool
+      = new std::vector<std::vector<char> >;
+  return *pool;
+}
+
+/* ---------------------------------------------------------------- */
+
+Semaphore&
+HttpData::get_buffer_pool_lock (void)
+{
+  static Semaphore* lock = new Semaphore;
+  return *lock;
+}
+
+/* ---------------------------------------------------------------- */
+
+HttpData::HttpData (void)
+  : http_code(0)
+{
+  std::vector<std::vector<char> >& pool = HttpData::get_buffer_pool();
+  Semaphore& lock = HttpData::get_buffer_pool_lock();
+
+  lock.wait();
+  if (!pool.empty())
+  {
+    this->data.swap(pool.back());
+    pool.pop_back();
+  }
+  lock.post();
+}
+
+/* ---------------------------------------------------------------- */
+
+HttpData::~HttpData (void)
+{
+  if (this->data.capacity() == 0
+      || this->data.capacity() > HTTP_BUFFER_POOL_MAX_CAPACITY)
+    return;
+
+  std::vector<std::vector<char> >& pool = HttpData::get_buffer_pool();
+  Semaphore& lock = HttpData::get_buffer_pool_lock();
+
+  this->data.clear();
+  lock.wait();
+  if (pool.size() < HTTP_BUFFER_POOL_SIZE)
+  {
+    pool.push_back(std::vector<char>());
+    pool.back().swap(this->data);
+  }
+  lock.post();
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+HttpData::reserve_data (std::size_t bytes)
+{
+  /* One more byte for the terminating zero appended when done. */
+  std::size_t needed = this->data.size() + bytes + 1;
+  if (needed <= this->data.capacity())
+    return;
+
+  /* Grow geometrically if the final size is unknown. */
+  std::size_t capacity = std::max(this->data.capacity() * 2,
+      (std::size_t)HTTP_BUFFER_INITIAL_SIZE);
+  this->data.reserve(std::max(needed, capacity));
+}
+
+/* ---------------------------------------------------------------- */
+
+std::string
+HttpData::get_header (char const* name) const
+{
+  std::size_t name_len = std::strlen(name);
+  for (std::size_t i = 0; i < this->headers.size(); ++i)
+  {
+    std::string const& header = this->headers[i];
+    if (header.size() <= name_len || header[name_len] != ':')
+      continue;
+
+    std::size_t j = 0;
+    while (j < name_len && std::tolower(header[j]) == std::tolower(name[j]))
+      j += 1;
+    if (j < name_len)
+      continue;
+
+    std::size_t value_pos = header.find_first_not_of(" \t", name_len + 1);
+    if (value_pos == std::string::npos)
+      return std::string();
+    return header.substr(value_pos);
+  }
+
+  return std::string();
+}
+
+/* ---------------------------------------------------------------- */
+
 void
 HttpData::dump_headers (void)
 {
@@ -55,99 +159,110 @@ Http::initialize_defaults (void)
   this->http_state = HTTP_STATE_READY;
   this->bytes_read = 0;
   this->bytes_total = 0;
+  this->header_list = 0;
 }
 
 /* ---------------------------------------------------------------- */
 
 HttpDataPtr
 Http::request (void)
+{
+  CURL * curl_handle = start_request();
+  CURLcode res = curl_easy_perform(curl_handle);
+  return finish_request(curl_handle, res);
+}
+
+/* ---------------------------------------------------------------- */
+
+CURL *
+Http::start_request (void)
 {
   // Set up variables
-  HttpDataPtr result = HttpData::create();
+  result = HttpData::create();
   std::stringstream url;
   unsigned int i;
 
-  CURL * curl_handle = NULL;
-  CURLcode res = CURLE_OK;
-  try
-  {
-    curl_handle = curl_easy_init();
-  
-    if (use_ssl)
-      url << "https://";
-    else
-      url << "http://";
-    url << host;
-    if (port != 443 && port != 80)
-      url << ":" << port;
-    url << path;
-
-    HttpCombo combo;
-    combo.http = this;
-    combo.httpdataptr = &result;
-
-    curl_easy_setopt(curl_handle, CURLOPT_NOSIGNAL, 1L);
-    curl_easy_setopt(curl_handle, CURLOPT_NOPROGRESS, 1L);
-    curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, Http::data_callback);
-    curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, (void *) &combo);
-    curl_easy_setopt(curl_handle, CURLOPT_HEADERFUNCTION, Http::header_callback);
-    curl_easy_setopt(curl_handle, CURLOPT_HEADERDATA, (void *) &combo);
-    curl_easy_setopt(curl_handle, CURLOPT_URL, url.str().c_str());
-    curl_easy_setopt(curl_handle, CURLOPT_USERAGENT, agent.c_str());
-  
-    if (proxy.size() > 0) {
-      curl_easy_setopt(curl_handle, CURLOPT_PROXY, proxy.c_str());
-      curl_easy_setopt(curl_handle, CURLOPT_PROXYPORT, (long) proxy_port);
-    }
-  
-    if (data.size() > 0) {
-      curl_easy_setopt(curl_handle, CURLOPT_POST, 1L);
-      curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDS, data.c_str());
-    }
-  
-    struct curl_slist *list = NULL;
-    if (headers.size() > 0) {
-      for (i = 0; i < headers.size(); i++)
-        list = curl_slist_append(list, headers[i].c_str());
-      curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, list);
-    }
-  
-    http_state = HTTP_STATE_CONNECTING;
-    res = curl_easy_perform(curl_handle);
-    
-    result->data.push_back(0);
-    curl_slist_free_all(list);
-  
-    long lhttp_code;
-    curl_easy_getinfo(curl_handle, CURLINFO_RESPONSE_CODE, &lhttp_code);
-    result->http_code = (HttpStatusCode) lhttp_code;
-  
-    // Error checking
-    if (res == CURLE_OK)
-      http_state = HTTP_STATE_DONE;
-    else
-      throw Exception(curl_easy_strerror(res));
-  }
-  catch (Exception & e)
+  CURL * curl_handle = CurlPool::acquire();
+  if (curl_handle == NULL)
   {
     http_state = HTTP_STATE_ERROR;
-    std::cout << "HTTP Failure: " << curl_easy_strerror(res) << std::endl;
-    curl_easy_cleanup(curl_handle);
-    throw Exception(e);
+    throw Exception("Could not create curl handle");
+  }
+
+  if (use_ssl)
+    url << "https://";
+  else
+    url << "http://";
+  url << host;
+  if (port != 443 && port != 80)
+    url << ":" << port;
+  url << path;
+
+  combo.http = this;
+  combo.httpdataptr = &result;
+  bytes_read = 0;
+  bytes_total = 0;
+
+  curl_easy_setopt(curl_handle, CURLOPT_NOSIGNAL, 1L);
+  curl_easy_setopt(curl_handle, CURLOPT_NOPROGRESS, 1L);
+  curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, Http::data_callback);
+  curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, (void *) &combo);
+  curl_easy_setopt(curl_handle, CURLOPT_HEADERFUNCTION, Http::header_callback);
+  curl_easy_setopt(curl_handle, CURLOPT_HEADERDATA, (void *) &combo);
+  curl_easy_setopt(curl_handle, CURLOPT_PRIVATE, (void *) this);
+  curl_easy_setopt(curl_handle, CURLOPT_URL, url.str().c_str());
+  curl_easy_setopt(curl_handle, CURLOPT_USERAGENT, agent.c_str());
+  /* Ask for any compression libcurl can decode, the data callback
+   * always receives the decoded document. */
+  curl_easy_setopt(curl_handle, CURLOPT_ACCEPT_ENCODING, "");
+
+  if (proxy.size() > 0) {
+    curl_easy_setopt(curl_handle, CURLOPT_PROXY, proxy.c_str());
+    curl_easy_setopt(curl_handle, CURLOPT_PROXYPORT, (long) proxy_port);
+  }
+
+  if (data.size() > 0) {
+    curl_easy_setopt(curl_handle, CURLOPT_POST, 1L);
+    curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDS, data.c_str());
   }
 
-  curl_easy_cleanup(curl_handle);
-  return result;
+  header_list = NULL;
+  if (headers.size() > 0) {
+    for (i = 0; i < headers.size(); i++)
+      header_list = curl_slist_append(header_list, headers[i].c_str());
+    curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, header_list);
+  }
+
+  http_state = HTTP_STATE_CONNECTING;
+  return curl_handle;
 }
 
 /* ---------------------------------------------------------------- */
 
-unsigned int
-Http::get_uint_from_str (std::string const& str)
+HttpDataPtr
+Http::finish_request (CURL * curl_handle, CURLcode res)
 {
-  std::stringstream ss(str);
-  int ret;
-  ss >> ret;
+  HttpDataPtr ret = result;
+  result.reset();
+
+  ret->data.push_back(0);
+  curl_slist_free_all(header_list);
+  header_list = NULL;
+
+  long lhttp_code;
+  curl_easy_getinfo(curl_handle, CURLINFO_RESPONSE_CODE, &lhttp_code);
+  ret->http_code = (HttpStatusCode) lhttp_code;
+  CurlPool::release(curl_handle);
+
+  // Error checking
+  if (res != CURLE_OK)
+  {
+    http_state = HTTP_STATE_ERROR;
+    std::cout << "HTTP Failure: " << curl_easy_strerror(res) << std::endl;
+    throw Exception(curl_easy_strerror(res));
+  }
+
+  http_state = HTTP_STATE_DONE;
   return ret;
 }
 
@@ -157,23 +272,48 @@ std::size_t
 Http::header_callback(char * buffer, std::size_t size, std::size_t nitems, void * combo)
 {
   std::size_t buffer_size = size * nitems;
-  if (buffer_size > 2) {
-    Http * http = ((HttpCombo *) combo)->http;
-    HttpDataPtr result = *((HttpCombo *) combo)->httpdataptr;
 
-    http->http_state = HTTP_STATE_RECEIVING;
-
-    std::string header_line;
-    header_line.assign(buffer, buffer_size);
-    while (!header_line.empty() && (*header_line.rbegin() == '\r' || *header_line.rbegin() == '\n'))
-      header_line.resize(header_line.size() - 1);
+  /* Strip the line break. */
+  std::size_t len = buffer_size;
+  while (len > 0 && (buffer[len - 1] == '\r' || buffer[len - 1] == '\n'))
+    len -= 1;
+  if (len == 0)
+    return buffer_size;
 
+  Http * http = ((HttpCombo *) combo)->http;
+  HttpData * result = ((HttpCombo *) combo)->httpdataptr->get();
 
-    result->headers.push_back(header_line);
+  http->http_state = HTTP_STATE_RECEIVING;
+  result->headers.push_back(std::string(buffer, len));
 
-    if (header_line.substr(0, 16) == "Content-Length: ")
-      http->bytes_total = http->get_uint_from_str(header_line.substr(16));
+  /* Header names are case insensitive (and lower case with HTTP/2). */
+  char const* name = "content-length:";
+  std::size_t name_len = std::strlen(name);
+  if (len > name_len)
+  {
+    std::size_t i = 0;
+    while (i < name_len && std::tolower(buffer[i]) == name[i])
+      i += 1;
+    if (i == name_len)
+    {
+      std::string value(buffer + name_len, len - name_len);
+      http->bytes_total = std::strtoul(value.c_str(), 0, 10);
+      /* Allocate the whole document at once. For compressed transfers
+       * this is only a lower bound of the decoded size. The value comes
+       * from the server, so it is capped. Exceptions must not pass
+       * through libcurl, returning 0 aborts the transfer instead. */
+      try
+      {
+        result->reserve_data(std::min(http->bytes_total,
+            (std::size_t)HTTP_BUFFER_MAX_RESERVE));
+      }
+      catch (std::bad_alloc&)
+      {
+        return 0;
+      }
+    }
   }
+
   return buffer_size;
 }
 
@@ -183,13 +323,19 @@ std::size_t
 Http::data_callback(char * buffer, std::size_t size, std::size_t nmemb, void * combo)
 {
   Http * http = ((HttpCombo *) combo)->http;
-  HttpDataPtr result = *((HttpCombo *) combo)->httpdataptr;
+  HttpData * result = ((HttpCombo *) combo)->httpdataptr->get();
 
-  unsigned long previous_size = result->data.size();
-  unsigned long current_size = previous_size + size * nmemb;
-  http->bytes_read = current_size;
-  result->data.resize(current_size);
-  memcpy(&result->data[previous_size], buffer, size * nmemb);
+  std::size_t bytes = size * nmemb;
+  try
+  {
+    result->reserve_data(bytes);
+    result->data.insert(result->data.end(), buffer, buffer + bytes);
+  }
+  catch (std::bad_alloc&)
+  {
+    return 0;
+  }
+  http->bytes_read = result->data.size();
 
-  return size * nmemb;
+  return bytes;
 }
@@ -19,8 +19,18 @@
 #include <curl/curl.h>
 
 #include "util/ref_ptr.h"
+#include "util/thread.h"
 #include "httpstatus.h"
 
+/* Amount of response buffers kept for reuse. */
+#define HTTP_BUFFER_POOL_SIZE 4
+/* Larger response buffers are freed instead of being reused. */
+#define HTTP_BUFFER_POOL_MAX_CAPACITY (4 * 1024 * 1024)
+/* Initial buffer size if the server doesn't send a Content-Length. */
+#define HTTP_BUFFER_INITIAL_SIZE (16 * 1024)
+/* Content-Length is only a hint, larger buffers grow while receiving. */
+#define HTTP_BUFFER_MAX_RESERVE (4 * HTTP_BUFFER_POOL_MAX_CAPACITY)
+
 enum HttpMethod
 {
   HTTP_METHOD_GET,
@@ -47,6 +57,14 @@ typedef ref_ptr<HttpData> HttpDataPtr;
 
 class HttpData
 {
+  private:
+    /* Response buffers of finished requests, reused to avoid
+     * growing a fresh buffer for every request. Both are never
+     * destroyed, so HttpData in other static objects can still
+     * return their buffers at exit. */
+    static std::vector<std::vector<char> >& get_buffer_pool (void);
+    static Semaphore& get_buffer_pool_lock (void);
+
   protected:
     HttpData (void);
 
@@ -57,6 +75,13 @@ class HttpData
 
   public:
     static HttpDataPtr create (void);
+    ~HttpData (void);
+
+    /* Makes room for the given amount of additional bytes. */
+    void reserve_data (std::size_t bytes);
+    /* Returns the value of the header with the given name (case
+     * insensitive) or an empty string. */
+    std::string get_header (char const* name) const;
 
     /* This is for debugging purposes. */
     void dump_headers (void);
@@ -65,6 +90,16 @@ class HttpData
 
 /* ---------------------------------------------------------------- */
 
+class Http;
+
+struct HttpCombo // A combo struct to pass to libcurl's C callback functions
+{
+  Http * http;
+  HttpDataPtr * httpdataptr;
+};
+
+/* ---------------------------------------------------------------- */
+
 /* Class for very simple requesting of documents over HTTP. */
 class Http
 {
@@ -86,9 +121,20 @@ class Http
     std::size_t bytes_read;
     std::size_t bytes_total;
 
+    /* State of the transfer in progress. */
+    HttpDataPtr result;
+    HttpCombo combo;
+    struct curl_slist* header_list;
+
   private:
     void initialize_defaults (void);
-    unsigned int get_uint_from_str (std::string const& str);
+
+  protected:
+    /* Creates a handle set up for the request. The transfer can then be
+     * performed with the easy or the multi interface. */
+    CURL* start_request (void);
+    /* Releases the handle and returns the document or throws. */
+    HttpDataPtr finish_request (CURL* handle, CURLcode res);
 
   public:
     Http (void);
@@ -129,23 +175,10 @@ class Http
 
 /* ---------------------------------------------------------------- */
 
-struct HttpCombo // A combo struct to pass to libcurl's C callback functions
-{
-  Http * http;
-  HttpDataPtr * httpdataptr;
-};
-
-/* ---------------------------------------------------------------- */
-
-inline
-HttpData::HttpData (void)
-{
-}
-
 inline HttpDataPtr
 HttpData::create (void)
 {
-  return HttpDataPtr(new HttpData);
+  return make_ref<HttpData>();
 }
 
 inline void
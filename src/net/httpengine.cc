@@ -0,0 +1,207 @@
+#include <algorithm>
+
+#include "asynchttp.h"
+#include "httpengine.h"
+
+HttpEngine* HttpEngine::instance = 0;
+Semaphore HttpEngine::instance_lock;
+
+/* ---------------------------------------------------------------- */
+
+HttpEngine::HttpEngine (void)
+  : idle_sem(0), running(false), sleeping(false), quit(false)
+{
+  this->multi = curl_multi_init();
+  curl_multi_setopt(this->multi, CURLMOPT_MAX_HOST_CONNECTIONS,
+      (long)HTTP_ENGINE_MAX_HOST_CONNECTIONS);
+}
+
+/* ---------------------------------------------------------------- */
+
+HttpEngine::~HttpEngine (void)
+{
+  curl_multi_cleanup(this->multi);
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+HttpEngine::submit (AsyncHttp* http)
+{
+  HttpEngine::instance_lock.wait();
+  if (HttpEngine::instance == 0)
+    HttpEngine::instance = new HttpEngine;
+  HttpEngine* engine = HttpEngine::instance;
+
+  engine->lock.wait();
+  engine->pending.push_back(http);
+  bool start_thread = !engine->running;
+  engine->running = true;
+  engine->lock.post();
+
+  if (start_thread)
+    engine->pt_create();
+  else
+    engine->wakeup();
+  HttpEngine::instance_lock.post();
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+HttpEngine::unload (void)
+{
+  HttpEngine::instance_lock.wait();
+  HttpEngine* engine = HttpEngine::instance;
+  HttpEngine::instance = 0;
+  HttpEngine::instance_lock.post();
+
+  if (engine == 0)
+    return;
+
+  engine->lock.wait();
+  engine->quit = true;
+  bool running = engine->running;
+  engine->lock.post();
+
+  if (running)
+  {
+    engine->wakeup();
+    engine->pt_join();
+  }
+
+  delete engine;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+HttpEngine::wakeup (void)
+{
+  this->lock.wait();
+  bool was_sleeping = this->sleeping;
+  this->sleeping = false;
+  this->lock.post();
+
+  if (was_sleeping)
+    this->idle_sem.post();
+#if LIBCURL_VERSION_NUM >= 0x074400
+  else
+    curl_multi_wakeup(this->multi);
+#endif
+}
+
+/* ---------------------------------------------------------------- */
+
+void*
+HttpEngine::run (void)
+{
+  while (true)
+  {
+    this->lock.wait();
+    bool stop = this->quit;
+    this->lock.post();
+    if (stop)
+      break;
+
+    this->start_pending();
+
+    int still_running = 0;
+    curl_multi_perform(this->multi, &still_running);
+    this->finish_transfers();
+
+    /* Sleep until the next transfer is submitted if there is nothing
+     * to do. Checked under the lock, so a submit can't be missed. */
+    this->lock.wait();
+    bool idle = this->active.empty() && this->pending.empty()
+        && !this->quit;
+    this->sleeping = idle;
+    this->lock.post();
+    if (idle)
+    {
+      this->idle_sem.wait();
+      continue;
+    }
+
+#if LIBCURL_VERSION_NUM >= 0x074400
+    curl_multi_poll(this->multi, 0, 0, HTTP_ENGINE_WAIT_MS, 0);
+#else
+    /* Without wakeup support, new transfers are picked up late
+     * unless the wait is short. */
+    curl_multi_wait(this->multi, 0, 0, 50, 0);
+#endif
+  }
+
+  /* Abort transfers that are still queued or running. */
+  this->start_pending();
+  for (std::size_t i = 0; i < this->active.size(); ++i)
+  {
+    curl_multi_remove_handle(this->multi, this->active[i]);
+    this->get_transfer(this->active[i])->finish_transfer
+        (this->active[i], CURLE_ABORTED_BY_CALLBACK);
+  }
+  this->active.clear();
+
+  return 0;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+HttpEngine::start_pending (void)
+{
+  this->lock.wait();
+  std::vector<AsyncHttp*> requests;
+  requests.swap(this->pending);
+  bool stop = this->quit;
+  this->lock.post();
+
+  for (std::size_t i = 0; i < requests.size(); ++i)
+  {
+    if (stop)
+    {
+      requests[i]->abort_transfer("Network engine stopped");
+      continue;
+    }
+
+    CURL* handle = requests[i]->start_transfer();
+    if (handle == 0)
+      continue;
+
+    curl_multi_add_handle(this->multi, handle);
+    this->active.push_back(handle);
+  }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+HttpEngine::finish_transfers (void)
+{
+  CURLMsg* msg;
+  int msgs_left;
+  while ((msg = curl_multi_info_read(this->multi, &msgs_left)) != 0)
+  {
+    if (msg->msg != CURLMSG_DONE)
+      continue;
+
+    CURL* handle = msg->easy_handle;
+    CURLcode res = msg->data.result;
+    curl_multi_remove_handle(this->multi, handle);
+    this->active.erase(std::find(this->active.begin(),
+        this->active.end(), handle));
+
+    /* The object may be deleted once the transfer is finished. */
+    this->get_transfer(handle)->finish_transfer(handle, res);
+  }
+}
+
+/* ---------------------------------------------------------------- */
+
+AsyncHttp*
+HttpEngine::get_transfer (CURL* handle)
+{
+  char* priv = 0;
+  curl_easy_getinfo(handle, CURLINFO_PRIVATE, &priv);
+  return (AsyncHttp*)(Http*)priv;
+}
@@ -0,0 +1,69 @@
+/*
+ * This file is part of GtkEveMon.
+ *
+ * GtkEveMon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GtkEveMon. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HTTP_ENGINE_HEADER
+#define HTTP_ENGINE_HEADER
+
+#include <vector>
+#include <curl/curl.h>
+
+#include "util/thread.h"
+
+/* Maximum time in milli seconds the I/O thread waits for activity
+ * while transfers are running. Without transfers it sleeps. */
+#define HTTP_ENGINE_WAIT_MS 1000
+/* Maximum amount of parallel connections to a single host. */
+#define HTTP_ENGINE_MAX_HOST_CONNECTIONS 8
+
+class AsyncHttp;
+
+/*
+ * Event-driven network engine. A single I/O thread drives all
+ * asynchronous transfers with the curl multi interface. Finished
+ * transfers are handed back to the AsyncHttp object, which delivers
+ * the result to the main loop. The thread is started with the first
+ * transfer and runs until unload() is called. Without transfers it
+ * sleeps until a new transfer is submitted.
+ */
+class HttpEngine : public Thread
+{
+  private:
+    static HttpEngine* instance;
+    static Semaphore instance_lock;
+
+    CURLM* multi;
+    Semaphore lock;
+    Semaphore idle_sem;
+    std::vector<AsyncHttp*> pending;
+    std::vector<CURL*> active;
+    bool running;
+    bool sleeping;
+    bool quit;
+
+  protected:
+    HttpEngine (void);
+    ~HttpEngine (void);
+
+    void* run (void);
+    void start_pending (void);
+    void finish_transfers (void);
+    void wakeup (void);
+    static AsyncHttp* get_transfer (CURL* handle);
+
+  public:
+    /* Queues the transfer. It's started by the I/O thread. */
+    static void submit (AsyncHttp* http);
+    /* Stops the I/O thread. Unfinished transfers are dropped. */
+    static void unload (void);
+};
+
+#endif /* HTTP_ENGINE_HEADER */
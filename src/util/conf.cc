@@ -18,7 +18,7 @@
 ConfValuePtr
 ConfValue::create (void)
 {
-  return ConfValuePtr(new ConfValue);
+  return make_ref<ConfValue>();
 }
 
 /* ---------------------------------------------------------------- */
@@ -103,7 +103,7 @@ ConfValue::set (bool _value)
 ConfSectionPtr
 ConfSection::create (void)
 {
-  return ConfSectionPtr(new ConfSection);
+  return make_ref<ConfSection>();
 }
 
 /* ---------------------------------------------------------------- */
@@ -311,10 +311,21 @@ Helpers::read_file (std::string const& filename, std::string* data,
 
 void
 Helpers::write_file (std::string const& filename, std::string const& data)
+{
+    Helpers::write_file(filename, data.c_str(), data.size());
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+Helpers::write_file (std::string const& filename,
+    char const* data, std::size_t size)
 {
     std::ofstream out(filename.c_str(), std::ios::binary);
     if (!out)
         throw FileException(filename, ::strerror(errno));
-    out.write(data.c_str(), data.size());
+    out.write(data, size);
     out.close();
+    if (!out)
+        throw FileException(filename, ::strerror(errno));
 }
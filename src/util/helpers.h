@@ -48,6 +48,8 @@ class Helpers
         bool auto_gunzip = false);
     static void write_file (std::string const& filename,
         std::string const& data);
+    static void write_file (std::string const& filename,
+        char const* data, std::size_t size);
 };
 
 #endif /* HELPERS_HEADER */
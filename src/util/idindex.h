@@ -0,0 +1,138 @@
+/*
+ * This file is part of GtkEveMon.
+ *
+ * GtkEveMon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GtkEveMon. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ID_INDEX_HEADER
+#define ID_INDEX_HEADER
+
+#include <vector>
+#include <utility>
+#include <cstddef>
+#include <stdint.h>
+
+/* Initial amount of slots, must be a power of two. */
+#define ID_INDEX_MIN_SLOTS 16
+
+/*
+ * A flat hash map from non-negative IDs to non-negative values,
+ * usually the index of an element in some vector. Linear probing
+ * over a power of two sized table keeps lookups O(1) and cache
+ * friendly. There is no removal; the index is cleared and rebuilt
+ * if elements are removed from the vector.
+ */
+class IdIndex
+{
+  private:
+    /* Slot keys are -1 for unused slots. */
+    std::vector<std::pair<int, int> > slots;
+    std::size_t count;
+
+  private:
+    std::size_t get_slot (int id) const;
+    void grow (void);
+
+  public:
+    IdIndex (void);
+
+    /* Removes all IDs from the index. */
+    void clear (void);
+    /* Adds the ID if it's not in the index. Returns false otherwise. */
+    bool insert (int id, int value);
+    /* Adds the ID or replaces the value if the ID is in the index. */
+    void set (int id, int value);
+    /* Returns the value for the ID, or -1 if the ID is unknown. */
+    int find (int id) const;
+
+    std::size_t size (void) const;
+    bool empty (void) const;
+};
+
+/* ---------------------------------------------------------------- */
+
+inline
+IdIndex::IdIndex (void)
+  : slots(ID_INDEX_MIN_SLOTS, std::make_pair(-1, -1)), count(0)
+{
+}
+
+inline std::size_t
+IdIndex::get_slot (int id) const
+{
+  /* Multiplicative hashing spreads consecutive IDs over the table. */
+  std::size_t mask = this->slots.size() - 1;
+  std::size_t slot = (std::size_t)((uint32_t)id * 2654435761u) & mask;
+  while (this->slots[slot].first != -1 && this->slots[slot].first != id)
+    slot = (slot + 1) & mask;
+  return slot;
+}
+
+inline void
+IdIndex::grow (void)
+{
+  std::vector<std::pair<int, int> > old_slots(this->slots.size() * 2,
+      std::make_pair(-1, -1));
+  std::swap(old_slots, this->slots);
+  for (std::size_t i = 0; i < old_slots.size(); ++i)
+    if (old_slots[i].first != -1)
+      this->slots[this->get_slot(old_slots[i].first)] = old_slots[i];
+}
+
+inline void
+IdIndex::clear (void)
+{
+  this->slots.assign(ID_INDEX_MIN_SLOTS, std::make_pair(-1, -1));
+  this->count = 0;
+}
+
+inline bool
+IdIndex::insert (int id, int value)
+{
+  /* Keep the table at most half full. */
+  if (2 * (this->count + 1) > this->slots.size())
+    this->grow();
+
+  std::pair<int, int>& slot = this->slots[this->get_slot(id)];
+  if (slot.first == id)
+    return false;
+
+  slot.first = id;
+  slot.second = value;
+  this->count += 1;
+  return true;
+}
+
+inline void
+IdIndex::set (int id, int value)
+{
+  if (!this->insert(id, value))
+    this->slots[this->get_slot(id)].second = value;
+}
+
+inline int
+IdIndex::find (int id) const
+{
+  std::pair<int, int> const& slot = this->slots[this->get_slot(id)];
+  return slot.first == id ? slot.second : -1;
+}
+
+inline std::size_t
+IdIndex::size (void) const
+{
+  return this->count;
+}
+
+inline bool
+IdIndex::empty (void) const
+{
+  return this->count == 0;
+}
+
+#endif /* ID_INDEX_HEADER */
@@ -14,6 +14,9 @@
 #define OS_HEADER
 
 #include <climits>
+#include <cstddef>
+#include <ctime>
+#include <stdint.h>
 
 class OS
 {
@@ -30,14 +33,23 @@ public:
   // TODO: define modes for mkdir() for all platforms?
   static bool  mkdir(char const* pathname/*, mode_t mode*/);
   static bool  unlink(char const* pathname);
+  /* Renames a file, replacing an existing file of the new name. */
+  static bool  rename_file (char const* from, char const* to);
   static std::size_t file_size (char const* pathname);
+  static time_t file_mtime (char const* pathname);
+  /* Maps a file read-only into memory. Returns 0 on error. */
+  static void* map_file (char const* pathname, std::size_t* size);
+  static void unmap_file (void* data, std::size_t size);
 
   /* Time interface. */
   static char* strptime (const char *buf, const char *fmt, struct tm *tm);
   static time_t timegm (struct tm *t);
+  /* Milli seconds from an unspecified start, never jumps back. */
+  static uint64_t monotonic_ms (void);
 
   /* Misc. */
   static int   execv(char const* path, char* const argv[]);
+  static unsigned int cpu_count(void);
 
   /* Endian conversions. */
   static short letoh(short x);
@@ -1,9 +1,12 @@
 #include <iostream>
 
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <pwd.h>
+#include <cstdio>
 #include <cstring>
 #include <ctime>
 
@@ -101,6 +104,17 @@ OS::unlink(char const* pathname)
 
 /* ---------------------------------------------------------------- */
 
+bool
+OS::rename_file (char const* from, char const* to)
+{
+  if (::rename(from, to) < 0)
+    return false;
+
+  return true;
+}
+
+/* ---------------------------------------------------------------- */
+
 std::size_t
 OS::file_size(char const* pathname)
 {
@@ -112,6 +126,51 @@ OS::file_size(char const* pathname)
 
 /* ---------------------------------------------------------------- */
 
+time_t
+OS::file_mtime (char const* pathname)
+{
+  struct stat filestats;
+  if (::stat(pathname, &filestats) < 0)
+    return 0;
+  return filestats.st_mtime;
+}
+
+/* ---------------------------------------------------------------- */
+
+void*
+OS::map_file (char const* pathname, std::size_t* size)
+{
+  int fd = ::open(pathname, O_RDONLY);
+  if (fd < 0)
+    return 0;
+
+  struct stat filestats;
+  if (::fstat(fd, &filestats) < 0 || filestats.st_size <= 0)
+  {
+    ::close(fd);
+    return 0;
+  }
+
+  void* data = ::mmap(0, static_cast<std::size_t>(filestats.st_size),
+      PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED)
+    return 0;
+
+  *size = static_cast<std::size_t>(filestats.st_size);
+  return data;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+OS::unmap_file (void* data, std::size_t size)
+{
+  ::munmap(data, size);
+}
+
+/* ---------------------------------------------------------------- */
+
 char*
 OS::strptime(const char *buf, const char *fmt, struct tm *tm)
 {
@@ -132,8 +191,29 @@ OS::timegm(struct tm *tm)
 
 /* ---------------------------------------------------------------- */
 
+uint64_t
+OS::monotonic_ms (void)
+{
+  struct timespec ts;
+  ::clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+/* ---------------------------------------------------------------- */
+
 int
 OS::execv (char const* path, char* const argv[])
 {
     return ::execv(path, argv);
 }
+
+/* ---------------------------------------------------------------- */
+
+unsigned int
+OS::cpu_count (void)
+{
+  long count = ::sysconf(_SC_NPROCESSORS_ONLN);
+  if (count < 1)
+    return 1;
+  return static_cast<unsigned int>(count);
+}
@@ -101,6 +101,17 @@ OS::unlink(char const* pathname)
 
 /* ---------------------------------------------------------------- */
 
+bool
+OS::rename_file (char const* from, char const* to)
+{
+  if (!::MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING))
+    return false;
+
+  return true;
+}
+
+/* ---------------------------------------------------------------- */
+
 std::size_t
 OS::file_size(char const* pathname)
 {
@@ -112,6 +123,57 @@ OS::file_size(char const* pathname)
 
 /* ---------------------------------------------------------------- */
 
+time_t
+OS::file_mtime (char const* pathname)
+{
+  struct _stat filestats;
+  if (::_stat(pathname, &filestats) < 0)
+    return 0;
+  return filestats.st_mtime;
+}
+
+/* ---------------------------------------------------------------- */
+
+void*
+OS::map_file (char const* pathname, std::size_t* size)
+{
+  HANDLE file = ::CreateFileA(pathname, GENERIC_READ, FILE_SHARE_READ,
+      NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE)
+    return 0;
+
+  LARGE_INTEGER file_size;
+  if (!::GetFileSizeEx(file, &file_size) || file_size.QuadPart <= 0)
+  {
+    ::CloseHandle(file);
+    return 0;
+  }
+
+  HANDLE mapping = ::CreateFileMappingA(file, NULL, PAGE_READONLY,
+      0, 0, NULL);
+  ::CloseHandle(file);
+  if (mapping == NULL)
+    return 0;
+
+  void* data = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  ::CloseHandle(mapping);
+  if (data == NULL)
+    return 0;
+
+  *size = static_cast<std::size_t>(file_size.QuadPart);
+  return data;
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+OS::unmap_file (void* data, std::size_t /*size*/)
+{
+  ::UnmapViewOfFile(data);
+}
+
+/* ---------------------------------------------------------------- */
+
 char*
 OS::strptime(const char *buf, const char *fmt, struct tm *tm)
 {
@@ -128,9 +190,29 @@ OS::timegm(struct tm *t)
 
 /* ---------------------------------------------------------------- */
 
+uint64_t
+OS::monotonic_ms (void)
+{
+  return (uint64_t)::GetTickCount64();
+}
+
+/* ---------------------------------------------------------------- */
+
 int
 OS::execv(char const* path, char* const argv[])
 {
     return ::_execv(path, argv);
 }
 
+
+/* ---------------------------------------------------------------- */
+
+unsigned int
+OS::cpu_count (void)
+{
+  SYSTEM_INFO info;
+  ::GetSystemInfo(&info);
+  if (info.dwNumberOfProcessors < 1)
+    return 1;
+  return static_cast<unsigned int>(info.dwNumberOfProcessors);
+}
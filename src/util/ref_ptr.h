@@ -18,32 +18,98 @@
 #ifndef REF_PTR_HEADER
 #define REF_PTR_HEADER
 
+#include <atomic>
+#include <utility>
+
+/* Reference count shared by all ref_ptr's to the same object.
+ * The count is atomic, so pointers may be copied across threads. */
+class ref_count
+{
+  public:
+    std::atomic<int> count;
+
+    ref_count (void) : count(1)
+      { }
+
+    virtual ~ref_count (void)
+      { }
+};
+
+/* Count for an object that was allocated separately. */
+template <class T>
+class ref_count_ptr : public ref_count
+{
+  private:
+    T* ptr;
+
+  public:
+    explicit ref_count_ptr (T* p) : ptr(p)
+      { }
+
+    ~ref_count_ptr (void)
+      { delete ptr; }
+};
+
+/* Count and object in a single allocation, see make_ref(). */
+template <class T>
+class ref_count_inplace : public ref_count
+{
+  private:
+    /* Derived to allow objects with protected constructors. */
+    class holder : public T
+    {
+      public:
+        template <class... A>
+        holder (A&&... args) : T(std::forward<A>(args)...)
+          { }
+    };
+
+  public:
+    holder object;
+
+    template <class... A>
+    ref_count_inplace (A&&... args) : object(std::forward<A>(args)...)
+      { }
+};
+
+template <class T> class ref_ptr;
+
+/* Creates the object with the given arguments and its count in a
+ * single allocation. Use this instead of ref_ptr<T>(new T). */
+template <class T, class... A>
+ref_ptr<T> make_ref (A&&... args);
+
+/* ---------------------------------------------------------------- */
+
 template <class T>
 class ref_ptr
 {
   /* Private declaration of class members. */
   private:
     T* ptr;
-    int* count;
+    ref_count* count;
 
   /* Private definition of member methods. */
   private:
+    ref_ptr (T* p, ref_count* c) : ptr(p), count(c)
+      { }
+
     void increment (void)
       {
-        if (ptr == 0) return;
-        ++(*count);
+        if (count == 0) return;
+        count->count.fetch_add(1, std::memory_order_relaxed);
       }
 
     void decrement (void)
       {
-        if (ptr == 0) return;
-        if (--(*count) == 0)
-          {
-            delete count;
-            delete ptr;
-          }
+        if (count == 0) return;
+        if (count->count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+          delete count;
       }
 
+    template <class Y, class... A>
+    friend ref_ptr<Y> make_ref (A&&... args);
+
   /* Public definition of member methods. */
   public:
     /* Ctor: Default one. */
@@ -52,12 +118,16 @@ class ref_ptr
 
     /* Ctor: From pointer. */
     explicit ref_ptr (T* p) : ptr(p)
-      { count = (p == 0) ? 0 : new int(1); }
+      { count = (p == 0) ? 0 : new ref_count_ptr<T>(p); }
 
     /* Ctor: Copy from other ref_ptr. */
     ref_ptr (const ref_ptr<T>& src) : ptr(src.ptr), count(src.count)
       { increment(); }
 
+    /* Ctor: Move from other ref_ptr, the count is not touched. */
+    ref_ptr (ref_ptr<T>&& src) : ptr(src.ptr), count(src.count)
+      { src.ptr = 0; src.count = 0; }
+
     /* Destructor. */
     ~ref_ptr (void)
       { decrement(); }
@@ -65,35 +135,47 @@ class ref_ptr
     /* Assignment: From other ref_ptr. */
     ref_ptr<T>& operator= (const ref_ptr<T>& rhs)
       {
-	if (rhs.ptr == ptr) return *this;
-	decrement();
+        if (rhs.ptr == ptr) return *this;
+        decrement();
         ptr = rhs.ptr;
         count = rhs.count;
         increment();
         return *this;
       }
 
+    /* Assignment: Move from other ref_ptr. */
+    ref_ptr<T>& operator= (ref_ptr<T>&& rhs)
+      {
+        if (&rhs == this) return *this;
+        decrement();
+        ptr = rhs.ptr;
+        count = rhs.count;
+        rhs.ptr = 0;
+        rhs.count = 0;
+        return *this;
+      }
+
     /* Assignment: From pointer. */
     ref_ptr<T>& operator= (T* rhs)
       {
-	if (rhs == ptr) return *this;
-	decrement();
+        if (rhs == ptr) return *this;
+        decrement();
         ptr = rhs;
-        count = (ptr == 0) ? 0 : new int(1);
-	return *this;
+        count = (ptr == 0) ? 0 : new ref_count_ptr<T>(ptr);
+        return *this;
       }
 
     /* Operations. */
     void reset (void)
       {
         decrement();
-	ptr = 0; count = 0;
+        ptr = 0; count = 0;
       }
 
     void swap (ref_ptr<T>& p)
       {
         T* tp = p.ptr; p.ptr = ptr; ptr = tp;
-	int *tc = p.count; p.count = count; count = tc;
+        ref_count* tc = p.count; p.count = count; count = tc;
       }
 
     /* Dereference. */
@@ -121,7 +203,7 @@ class ref_ptr
 
     /* Information. */
     int use_count (void) const
-      { return (count == 0) ? 0 : *count; }
+      { return (count == 0) ? 0 : count->count.load(); }
 
     T* get (void) const
       { return ptr; }
@@ -136,7 +218,7 @@ class ref_ptr
     /* Ctor: From diffrent pointer. */
     template <class Y>
     explicit ref_ptr (Y* p) : ptr(static_cast<T*>(p))
-      { count = (p == 0) ? 0 : new int(1); }
+      { count = (p == 0) ? 0 : new ref_count_ptr<Y>(p); }
 
     /* Ctor: Copy from diffrent ref_ptr. */
     template <class Y>
@@ -147,16 +229,26 @@ class ref_ptr
         increment();
       }
 
+    /* Ctor: Move from diffrent ref_ptr. */
+    template <class Y>
+    ref_ptr (ref_ptr<Y>&& src)
+      {
+        ptr = static_cast<T*>(src.ptr);
+        count = src.count;
+        src.ptr = 0;
+        src.count = 0;
+      }
+
     /* Assignment: From diffrent ref_ptr. */
     template <class Y>
     ref_ptr<T>& operator= (const ref_ptr<Y>& rhs)
       {
         if (rhs.ptr == ptr) return *this;
         decrement();
-	ptr = static_cast<T*>(rhs.ptr);
-	count = rhs.count;
-	increment();
-	return *this;
+        ptr = static_cast<T*>(rhs.ptr);
+        count = rhs.count;
+        increment();
+        return *this;
       }
 
     /* Assignment: From diffrent pointer. */
@@ -164,10 +256,10 @@ class ref_ptr
     ref_ptr<T>& operator= (Y* rhs)
       {
         if (rhs == ptr) return *this;
-	decrement();
-	ptr = static_cast<T*>(rhs);
-	count = (ptr == 0) ? 0 : new int(1);
-	return *this;
+        decrement();
+        ptr = static_cast<T*>(rhs);
+        count = (ptr == 0) ? 0 : new ref_count_ptr<Y>(rhs);
+        return *this;
       }
 
     /* Comparison with diffrent ref_ptr type. */
@@ -186,4 +278,15 @@ class ref_ptr
   #endif /* NO_MEMBER_TEMPLATES */
 };
 
+/* ---------------------------------------------------------------- */
+
+template <class T, class... A>
+ref_ptr<T>
+make_ref (A&&... args)
+{
+  ref_count_inplace<T>* block
+      = new ref_count_inplace<T>(std::forward<A>(args)...);
+  return ref_ptr<T>(&block->object, block);
+}
+
 #endif /* REF_PTR_HEADER */
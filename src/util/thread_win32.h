@@ -82,7 +82,8 @@ class Semaphore
     Semaphore (unsigned int value = 1)
     {
       this->value = value;
-      this->sem = CreateSemaphore(NULL, value, value, NULL);
+      /* The maximum allows counting semaphores, not only mutexes. */
+      this->sem = CreateSemaphore(NULL, value, LONG_MAX, NULL);
     }
 
     /* DOWN the semaphore. */
@@ -101,7 +102,7 @@ class Semaphore
     int post (void)
     {
       InterlockedIncrement(&this->value);
-      if (ReleaseSemaphore(this->sem, 1, NULL))
+      if (!ReleaseSemaphore(this->sem, 1, NULL))
       {
         InterlockedDecrement(&this->value);
         return -1;
@@ -0,0 +1,251 @@
+/*
+ * This file is part of GtkEveMon.
+ *
+ * GtkEveMon is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with GtkEveMon. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Compares the DOM and the streaming parser on an API or tree XML file.
+ * Prints the time per parse and the peak memory allocated by libxml2.
+ */
+
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <sys/time.h>
+#include <libxml/xmlmemory.h>
+#include <libxml/parser.h>
+
+#include "util/helpers.h"
+#include "util/exception.h"
+#include "api/apicharsheet.h"
+#include "api/apiskillqueue.h"
+#include "api/apiskilltree.h"
+#include "api/apicerttree.h"
+
+/* Every allocation is prefixed with its size to track the peak. */
+#define MEM_HEADER_SIZE 16
+
+std::size_t mem_current = 0;
+std::size_t mem_peak = 0;
+
+void
+mem_track (std::size_t size, bool alloc)
+{
+  if (alloc)
+    mem_current += size;
+  else
+    mem_current -= size;
+  if (mem_current > mem_peak)
+    mem_peak = mem_current;
+}
+
+void*
+mem_malloc (std::size_t size)
+{
+  char* ptr = (char*)std::malloc(size + MEM_HEADER_SIZE);
+  if (ptr == 0)
+    return 0;
+  *(std::size_t*)ptr = size;
+  mem_track(size, true);
+  return ptr + MEM_HEADER_SIZE;
+}
+
+void
+mem_free (void* mem)
+{
+  if (mem == 0)
+    return;
+  char* ptr = (char*)mem - MEM_HEADER_SIZE;
+  mem_track(*(std::size_t*)ptr, false);
+  std::free(ptr);
+}
+
+void*
+mem_realloc (void* mem, std::size_t size)
+{
+  if (mem == 0)
+    return mem_malloc(size);
+
+  char* ptr = (char*)mem - MEM_HEADER_SIZE;
+  std::size_t old_size = *(std::size_t*)ptr;
+  ptr = (char*)std::realloc(ptr, size + MEM_HEADER_SIZE);
+  if (ptr == 0)
+    return 0;
+  *(std::size_t*)ptr = size;
+  mem_track(old_size, false);
+  mem_track(size, true);
+  return ptr + MEM_HEADER_SIZE;
+}
+
+char*
+mem_strdup (char const* str)
+{
+  std::size_t len = std::strlen(str) + 1;
+  char* ret = (char*)mem_malloc(len);
+  if (ret != 0)
+    std::memcpy(ret, str, len);
+  return ret;
+}
+
+/* ---------------------------------------------------------------- */
+
+/* The parsers are protected, these classes make them accessible. */
+class BenchCharSheet : public ApiCharSheet
+{
+  public:
+    void parse (std::string const& data, bool stream)
+    {
+      this->skills.clear();
+      this->certs.clear();
+      this->skill_index.clear();
+      this->cert_index.clear();
+      if (stream)
+        this->parse_stream(data.c_str(), data.size());
+      else
+        this->parse_dom(data.c_str(), data.size());
+    }
+};
+
+class BenchSkillQueue : public ApiSkillQueue
+{
+  public:
+    void parse (std::string const& data, bool stream)
+    {
+      this->queue.clear();
+      if (stream)
+        this->parse_stream(data.c_str(), data.size());
+      else
+        this->parse_dom(data.c_str(), data.size());
+    }
+};
+
+class BenchSkillTree : public ApiSkillTree
+{
+  public:
+    void parse (std::string const& data, bool stream)
+    {
+      if (stream)
+        this->parse_stream(data.c_str(), data.size());
+      else
+        this->parse_dom(data.c_str(), data.size());
+    }
+};
+
+class BenchCertTree : public ApiCertTree
+{
+  public:
+    void parse (std::string const& data, bool stream)
+    {
+      if (stream)
+        this->parse_stream(data.c_str(), data.size());
+      else
+        this->parse_dom(data.c_str(), data.size());
+    }
+};
+
+/* ---------------------------------------------------------------- */
+
+double
+get_seconds (void)
+{
+  struct timeval tv;
+  ::gettimeofday(&tv, 0);
+  return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+/* ---------------------------------------------------------------- */
+
+template <class T>
+void
+run_bench (std::string const& data, int iterations)
+{
+  char const* names[] = { "DOM", "Stream" };
+  for (int i = 0; i < 2; ++i)
+  {
+    bool stream = (i == 1);
+    mem_current = 0;
+    mem_peak = 0;
+
+    double start = get_seconds();
+    for (int j = 0; j < iterations; ++j)
+    {
+      /* Parse into a fresh object like a tree refresh does. */
+      T target;
+      target.parse(data, stream);
+    }
+    double secs = get_seconds() - start;
+
+    std::cout << names[i] << ": " << (secs * 1000.0 / iterations)
+        << " ms per parse, peak libxml2 memory "
+        << (mem_peak / 1024) << " KB" << std::endl;
+  }
+}
+
+/* ---------------------------------------------------------------- */
+
+void
+usage (char** argv)
+{
+  std::cerr << "Usage: " << argv[0] << " TYPE FILE [ITERATIONS]" << std::endl
+      << "TYPE is one of charsheet, skillqueue, skilltree or certtree."
+      << std::endl;
+}
+
+/* ---------------------------------------------------------------- */
+
+int
+main (int argc, char** argv)
+{
+  if (argc < 3 || argc > 4)
+  {
+    usage(argv);
+    return EXIT_FAILURE;
+  }
+
+  /* Must be set up before libxml2 allocates anything. */
+  xmlMemSetup(mem_free, mem_malloc, mem_realloc, mem_strdup);
+  xmlInitParser();
+
+  std::string type(argv[1]);
+  int iterations = (argc == 4 ? Helpers::get_int_from_string(argv[3]) : 100);
+  if (iterations <= 0)
+    iterations = 1;
+
+  try
+  {
+    std::string data;
+    Helpers::read_file(argv[2], &data, true);
+    std::cout << "Parsing " << argv[2] << " (" << data.size()
+        << " bytes), " << iterations << " iterations" << std::endl;
+
+    if (type == "charsheet")
+      run_bench<BenchCharSheet>(data, iterations);
+    else if (type == "skillqueue")
+      run_bench<BenchSkillQueue>(data, iterations);
+    else if (type == "skilltree")
+      run_bench<BenchSkillTree>(data, iterations);
+    else if (type == "certtree")
+      run_bench<BenchCertTree>(data, iterations);
+    else
+    {
+      usage(argv);
+      return EXIT_FAILURE;
+    }
+  }
+  catch (Exception& e)
+  {
+    std::cerr << "Error: " << e << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  xmlCleanupParser();
+  return EXIT_SUCCESS;
+}